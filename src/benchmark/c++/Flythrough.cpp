@@ -0,0 +1,316 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <simplicity/model/ModelFactory.h>
+#include <simplicity/model/SimpleModelFactory.h>
+
+#include <simplicity/terrain/API.h>
+
+#include "simplicity/terrain/benchmark/CountingTerrainSource.h"
+#include "simplicity/terrain/benchmark/MemoryResource.h"
+
+using namespace simplicity;
+using namespace simplicity::terrain;
+using namespace simplicity::terrain::benchmark;
+using namespace std;
+
+namespace
+{
+	const unsigned int CHUNK_SIZE = 32;
+
+	// The heights of the terrain are all within plus or minus this.
+	const float HEIGHT_LIMIT = 72.0f;
+
+	const unsigned int MAP_SIZE = 1024;
+
+	const float PI = 3.14159265359f;
+
+	// Far enough inside the map that the streamed area never reaches its edge.
+	const float REACH = 300.0f;
+
+	struct Path
+	{
+		string name;
+
+		vector<Vector3> positions;
+	};
+
+	struct Strategy
+	{
+		string name;
+
+		// Holds loaded and prefetched chunks as compact vertices until they are committed.
+		bool compact;
+
+		unsigned int rebuildBudget;
+
+		unsigned int stagingCapacity;
+
+		unsigned int workerCount;
+	};
+
+	float getTerrainHeight(int x, int y)
+	{
+		return sin(x * 0.05f) * 40.0f + cos(y * 0.04f) * 30.0f + sin((x + y) * 0.3f) * 2.0f;
+	}
+
+	// Nearest rank, the values must be sorted.
+	template<typename Value>
+	Value getPercentile(const vector<Value>& values, float percentile)
+	{
+		unsigned int rank = static_cast<unsigned int>(ceil(percentile / 100.0f * values.size()));
+		return values[max(rank, 1u) - 1];
+	}
+
+	vector<Path> createPaths(unsigned int frameCount)
+	{
+		vector<Path> paths(4);
+
+		// Across the middle of the map, crossing a chunk boundary every few frames.
+		paths[0].name = "straight";
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			float progress = static_cast<float>(frame) / frameCount;
+			paths[0].positions.push_back(Vector3(-REACH + progress * REACH * 2.0f, 0.0f, 10.0f));
+		}
+
+		paths[1].name = "circle";
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			float angle = static_cast<float>(frame) / frameCount * PI * 2.0f;
+			paths[1].positions.push_back(Vector3(cos(angle) * REACH * 0.66f, 0.0f, sin(angle) * REACH * 0.66f));
+		}
+
+		// Back and forth across the east edge of the chunk it starts in, streaming a column of chunks at every
+		// crossing.
+		paths[2].name = "oscillation";
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			float angle = static_cast<float>(frame) / 30.0f * PI * 2.0f;
+			paths[2].positions.push_back(Vector3((0.5f - cos(angle) * 0.25f) * CHUNK_SIZE, 0.0f, 10.0f));
+		}
+
+		// Still between jumps to somewhere new every second at 60 frames per second.
+		paths[3].name = "teleports";
+		mt19937 random(1);
+		uniform_real_distribution<float> distribution(-REACH, REACH);
+		Vector3 position(0.0f, 0.0f, 0.0f);
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			if (frame % 60 == 59)
+			{
+				position = Vector3(distribution(random), 0.0f, distribution(random));
+			}
+
+			paths[3].positions.push_back(position);
+		}
+
+		return paths;
+	}
+
+	// One position per line as the x and z coordinates separated by whitespace.
+	Path readPath(const string& fileName)
+	{
+		ifstream file(fileName);
+		if (!file)
+		{
+			throw runtime_error("Could not open path " + fileName);
+		}
+
+		Path path;
+		path.name = fileName;
+
+		float x;
+		float z;
+		while (file >> x >> z)
+		{
+			path.positions.push_back(Vector3(x, 0.0f, z));
+		}
+
+		return path;
+	}
+
+	// Returns the number of chunks rebuilt from prefetched chunks.
+	unsigned long replay(const Path& path, const Strategy& strategy, const MemoryResource& resource,
+						 const vector<LevelOfDetail>& lods, chrono::milliseconds frameTime)
+	{
+		ResourceTerrainSource resourceSource(Vector2ui(MAP_SIZE, MAP_SIZE), resource, lods);
+		CountingTerrainSource* source = new CountingTerrainSource(resourceSource);
+
+		Entity entity;
+		TerrainStreamer* streamer = new TerrainStreamer(unique_ptr<TerrainSource>(source),
+				Vector2ui(MAP_SIZE, MAP_SIZE), CHUNK_SIZE, lods, strategy.workerCount);
+		if (strategy.compact)
+		{
+			streamer->setCompactHeightRange(-HEIGHT_LIMIT, HEIGHT_LIMIT);
+		}
+		streamer->setPrefetch(strategy.stagingCapacity, 30.0f);
+		streamer->setRebuildBudget(strategy.rebuildBudget);
+		entity.addComponent(unique_ptr<Component>(streamer));
+
+		// The entity is never added to a scene, so the streamer is started by hand. Its first build is not
+		// measured, every strategy starts with all of its chunks.
+		streamer->setTarget(path.positions.front());
+		streamer->onAddEntity();
+		while (streamer->getPendingChunkCount() > 0)
+		{
+			this_thread::sleep_for(chrono::milliseconds(1));
+			streamer->execute();
+		}
+
+		unsigned long long firstByteCount = resource.getBytesRead();
+		unsigned int firstSectionCount = source->getSectionCount();
+		unsigned long firstPrefetchHitCount = streamer->getPrefetchHitCount();
+
+		vector<double> executeTimes;
+		vector<unsigned int> chunkCounts;
+		for (const Vector3& position : path.positions)
+		{
+			chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+			unsigned int sectionCount = source->getSectionCount();
+
+			streamer->setTarget(position);
+			streamer->execute();
+
+			executeTimes.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - frameStart).count());
+			chunkCounts.push_back(source->getSectionCount() - sectionCount);
+
+			if (frameTime.count() > 0)
+			{
+				this_thread::sleep_until(frameStart + frameTime);
+			}
+		}
+
+		// Chunks built by the loader are counted in the frame they were read in, those it has not finished are
+		// reported as pending.
+		unsigned int chunkCount = source->getSectionCount() - firstSectionCount;
+		unsigned long long byteCount = resource.getBytesRead() - firstByteCount;
+		unsigned long prefetchHitCount = streamer->getPrefetchHitCount() - firstPrefetchHitCount;
+
+		sort(executeTimes.begin(), executeTimes.end());
+		sort(chunkCounts.begin(), chunkCounts.end());
+
+		cout << "{\"path\":\"" << path.name << "\",\"strategy\":\"" << strategy.name << "\",\"frames\":" <<
+				path.positions.size() << ",\"executeMicroseconds\":{\"p50\":" << getPercentile(executeTimes, 50.0f) <<
+				",\"p99\":" << getPercentile(executeTimes, 99.0f) << ",\"max\":" << executeTimes.back() <<
+				"},\"chunksBuilt\":{\"total\":" << chunkCount << ",\"p50PerFrame\":" <<
+				getPercentile(chunkCounts, 50.0f) << ",\"p99PerFrame\":" << getPercentile(chunkCounts, 99.0f) <<
+				",\"maxPerFrame\":" << chunkCounts.back() << ",\"pending\":" << streamer->getPendingChunkCount() <<
+				",\"prefetchHits\":" << prefetchHitCount << "},\"bytesRead\":" << byteCount << "}" << endl;
+
+		return prefetchHitCount;
+	}
+}
+
+// Replays paths of the streamer's target under each streaming strategy and writes one line of JSON per replay to
+// the standard output. Fails if a strategy that prefetches never uses a prefetched chunk. The options are:
+//   --frames n       the number of frames in each scripted path, 240 by default
+//   --frame-time ms  the time given to each frame so loader threads run as they would in a game, 16 by default
+//   --path file      replays a recorded path as well
+int main(int argc, char** argv)
+{
+	unsigned int frameCount = 240;
+	chrono::milliseconds frameTime(16);
+	vector<string> recordedPaths;
+
+	for (int index = 1; index + 1 < argc; index += 2)
+	{
+		string option = argv[index];
+		if (option == "--frames")
+		{
+			frameCount = static_cast<unsigned int>(stoul(argv[index + 1]));
+		}
+		else if (option == "--frame-time")
+		{
+			frameTime = chrono::milliseconds(stoi(argv[index + 1]));
+		}
+		else if (option == "--path")
+		{
+			recordedPaths.push_back(argv[index + 1]);
+		}
+		else
+		{
+			cerr << "Unknown option " << option << endl;
+			return 1;
+		}
+	}
+
+	if (frameCount == 0 || argc % 2 == 0)
+	{
+		cerr << "Usage: " << argv[0] << " [--frames n] [--frame-time ms] [--path file]..." << endl;
+		return 1;
+	}
+
+	// Meshes are kept in memory rather than uploaded to a renderer.
+	ModelFactory::setInstance(unique_ptr<ModelFactory>(new SimpleModelFactory));
+
+	vector<LevelOfDetail> lods(3);
+	for (unsigned int index = 0; index < lods.size(); index++)
+	{
+		lods[index].layerCount = 2;
+		lods[index].sampleFrequency = 1u << index;
+	}
+
+	MemoryResource resource;
+	TerrainFactory::createFlatTerrain(resource, Vector2ui(MAP_SIZE, MAP_SIZE), getTerrainHeight, { 1, 2, 4 });
+
+	vector<Path> paths = createPaths(frameCount);
+	for (const string& recordedPath : recordedPaths)
+	{
+		paths.push_back(readPath(recordedPath));
+		if (paths.back().positions.empty())
+		{
+			cerr << "The path " << recordedPath << " has no positions" << endl;
+			return 1;
+		}
+	}
+
+	// Name, compact vertices, rebuild budget, staging capacity and worker count.
+	vector<Strategy> strategies =
+	{
+		{ "synchronous", false, 0, 0, 0 },
+		{ "budgeted", false, 4, 0, 0 },
+		{ "asynchronous", false, 0, 0, 2 },
+		{ "prefetching", false, 0, 16, 2 },
+		{ "compactPrefetching", true, 0, 16, 2 }
+	};
+
+	map<string, unsigned long> prefetchHitCounts;
+	for (const Path& path : paths)
+	{
+		for (const Strategy& strategy : strategies)
+		{
+			prefetchHitCounts[strategy.name] += replay(path, strategy, resource, lods, frameTime);
+		}
+	}
+
+	// A strategy that stages chunks no rebuild uses is measuring the same thing as one that does not stage them.
+	for (const Strategy& strategy : strategies)
+	{
+		if (strategy.stagingCapacity > 0 && prefetchHitCounts[strategy.name] == 0)
+		{
+			cerr << "The " << strategy.name << " strategy never rebuilt a chunk from a prefetched one" << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,229 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include <simplicity/model/ModelFactory.h>
+#include <simplicity/model/SimpleModelFactory.h>
+
+#include <simplicity/terrain/API.h>
+
+#include "simplicity/terrain/benchmark/Benchmark.h"
+#include "simplicity/terrain/benchmark/MemoryResource.h"
+
+using namespace simplicity;
+using namespace simplicity::terrain;
+using namespace simplicity::terrain::benchmark;
+using namespace std;
+
+namespace
+{
+	const unsigned int CHUNK_SIZES[] = { 16, 32, 64 };
+
+	// The heights of the terrain are all within plus or minus this.
+	const float HEIGHT_LIMIT = 72.0f;
+
+	const unsigned int MAP_SIZES[] = { 256, 1024 };
+
+	float getTerrainHeight(int x, int y)
+	{
+		return sin(x * 0.05f) * 40.0f + cos(y * 0.04f) * 30.0f + sin((x + y) * 0.3f) * 2.0f;
+	}
+
+	// The north west corners of the chunks of the map, visited in turn so the benchmarks do not read the same
+	// section every time.
+	vector<Vector2i> getSectionNorthWests(unsigned int mapSize, unsigned int chunkSize)
+	{
+		vector<Vector2i> northWests;
+
+		int halfMapSize = static_cast<int>(mapSize / 2);
+		for (int y = -halfMapSize; y < halfMapSize; y += static_cast<int>(chunkSize))
+		{
+			for (int x = -halfMapSize; x < halfMapSize; x += static_cast<int>(chunkSize))
+			{
+				northWests.push_back(Vector2i(x, y));
+			}
+		}
+
+		return northWests;
+	}
+
+	void runChunkBenchmarks(Benchmark& benchmark, const TerrainSource& source, unsigned int mapSize,
+							unsigned int chunkSize)
+	{
+		map<string, unsigned int> parameters { { "chunkSize", chunkSize }, { "mapSize", mapSize } };
+		vector<Vector2i> northWests = getSectionNorthWests(mapSize, chunkSize);
+		unsigned int next = 0;
+
+		unsigned int samples = chunkSize + 1;
+		vector<float> heights(samples * samples);
+		vector<Vector3> normals(samples * samples);
+		TerrainScratch scratch;
+
+		benchmark.run("getSection", parameters, [&]()
+		{
+			source.getSection(northWests[next++ % northWests.size()], Vector2ui(chunkSize, chunkSize), 0,
+							  heights.data(), sizeof(float), normals.data(), sizeof(Vector3), scratch);
+		});
+
+		benchmark.run("getSectionHeights", parameters, [&]()
+		{
+			source.getSectionHeights(northWests[next++ % northWests.size()], Vector2ui(chunkSize, chunkSize), 0,
+									 heights.data(), sizeof(float), scratch);
+		});
+
+		benchmark.run("getSectionNormals", parameters, [&]()
+		{
+			source.getSectionNormals(northWests[next++ % northWests.size()], Vector2ui(chunkSize, chunkSize), 0,
+									 normals.data(), sizeof(Vector3), scratch);
+		});
+
+		TerrainChunk chunk(chunkSize);
+		unique_ptr<Model> model = chunk.createModel();
+
+		benchmark.run("setVertices", parameters, [&]()
+		{
+			const Vector2i& northWest = northWests[next++ % northWests.size()];
+			chunk.setVertices(northWest, source, northWest, 0, scratch);
+		});
+
+		TerrainChunk::CompactVertices compactVertices;
+		compactVertices.maximumHeight = HEIGHT_LIMIT;
+		compactVertices.minimumHeight = -HEIGHT_LIMIT;
+
+		benchmark.run("fillCompactVertices", parameters, [&]()
+		{
+			chunk.fillVertices(source, northWests[next++ % northWests.size()], 0, compactVertices, scratch);
+		});
+
+		benchmark.run("setCompactVertices", parameters, [&]()
+		{
+			chunk.setVertices(northWests[next++ % northWests.size()], compactVertices);
+		});
+
+		// Taking over a model resets its indices.
+		benchmark.run("setIndices", parameters, [&]()
+		{
+			chunk.setModel(*model);
+		});
+
+		TerrainChunk::Patches unpatched = chunk.getPatches();
+		TerrainChunk::Patches patched = unpatched;
+		patched.east = 2;
+		patched.north = 2;
+		bool patch = false;
+
+		benchmark.run("patch", parameters, [&]()
+		{
+			patch = !patch;
+			chunk.patch(patch ? patched : unpatched);
+		});
+
+		// A batch of queries per run, the call of each run costs about as much as a single query.
+		const unsigned int queryCount = 1024;
+		vector<Vector3> positions;
+		mt19937 random(1);
+		uniform_real_distribution<float> distribution(0.0f, static_cast<float>(chunkSize));
+		for (unsigned int index = 0; index < queryCount; index++)
+		{
+			positions.push_back(Vector3(distribution(random), 0.0f, distribution(random)));
+		}
+
+		map<string, unsigned int> queryParameters = parameters;
+		queryParameters["queries"] = queryCount;
+		volatile float heightSum = 0.0f;
+
+		benchmark.run("getHeight", queryParameters, [&]()
+		{
+			float sum = 0.0f;
+			for (const Vector3& position : positions)
+			{
+				sum += chunk.getHeight(position);
+			}
+
+			heightSum = sum;
+		});
+	}
+
+	void runStreamBenchmark(Benchmark& benchmark, const MemoryResource& resource, unsigned int mapSize,
+							unsigned int chunkSize, const vector<LevelOfDetail>& lods)
+	{
+		Entity entity;
+		TerrainStreamer* streamer = new TerrainStreamer(unique_ptr<TerrainSource>(
+				new ResourceTerrainSource(Vector2ui(mapSize, mapSize), resource, lods)),
+				Vector2ui(mapSize, mapSize), chunkSize, lods);
+		entity.addComponent(unique_ptr<Component>(streamer));
+
+		// The entity is never added to a scene, so the streamer is started by hand.
+		streamer->setTarget(Vector3(0.0f, 0.0f, 0.0f));
+		streamer->onAddEntity();
+
+		// Each run moves the target a chunk east, turning back at the edges of the map, so every run streams in a
+		// column of chunks.
+		float limit = static_cast<float>(mapSize / 2 - chunkSize);
+		float step = static_cast<float>(chunkSize);
+		Vector3 target(0.0f, 0.0f, 0.0f);
+
+		benchmark.run("stream", { { "chunkSize", chunkSize }, { "mapSize", mapSize } }, [&]()
+		{
+			if (fabs(target.X() + step) > limit)
+			{
+				step = -step;
+			}
+
+			target.X() += step;
+			streamer->setTarget(target);
+			streamer->execute();
+		});
+	}
+}
+
+// Writes one line of JSON per result to the standard output. The optional argument is the minimum number of
+// milliseconds to run each benchmark for.
+int main(int argc, char** argv)
+{
+	chrono::milliseconds minimumDuration(argc > 1 ? stoi(argv[1]) : 200);
+
+	// Meshes are kept in memory rather than uploaded to a renderer.
+	ModelFactory::setInstance(unique_ptr<ModelFactory>(new SimpleModelFactory));
+
+	Benchmark benchmark(cout, minimumDuration);
+
+	vector<LevelOfDetail> lods(2);
+	lods[0].layerCount = 2;
+	lods[0].sampleFrequency = 1;
+	lods[1].layerCount = 2;
+	lods[1].sampleFrequency = 2;
+
+	for (unsigned int mapSize : MAP_SIZES)
+	{
+		MemoryResource resource;
+
+		benchmark.run("createFlatTerrain", { { "mapSize", mapSize } }, [&]()
+		{
+			resource.setData(string());
+			TerrainFactory::createFlatTerrain(resource, Vector2ui(mapSize, mapSize), getTerrainHeight, { 1, 2 });
+		});
+
+		ResourceTerrainSource source(Vector2ui(mapSize, mapSize), resource, lods);
+
+		for (unsigned int chunkSize : CHUNK_SIZES)
+		{
+			runChunkBenchmarks(benchmark, source, mapSize, chunkSize);
+			runStreamBenchmark(benchmark, resource, mapSize, chunkSize, lods);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace benchmark
+		{
+			Benchmark::Benchmark(ostream& output, chrono::milliseconds minimumDuration) :
+				minimumDuration(minimumDuration),
+				output(output)
+			{
+			}
+
+			void Benchmark::run(const string& name, const map<string, unsigned int>& parameters,
+								const function<void()>& operation)
+			{
+				// Once to warm up caches and scratch buffers.
+				operation();
+
+				// Timed in batches that double until each takes long enough to measure, the fastest batch is reported
+				// as it is the least disturbed by the rest of the system.
+				unsigned int batchSize = 1;
+				unsigned long long iterations = 0;
+				vector<double> batchTimes;
+				chrono::steady_clock::duration elapsed(0);
+
+				while (elapsed < minimumDuration || batchTimes.size() < 5)
+				{
+					chrono::steady_clock::time_point start = chrono::steady_clock::now();
+					for (unsigned int index = 0; index < batchSize; index++)
+					{
+						operation();
+					}
+					chrono::steady_clock::duration batchTime = chrono::steady_clock::now() - start;
+
+					elapsed += batchTime;
+					iterations += batchSize;
+
+					if (batchTime < chrono::microseconds(100))
+					{
+						batchSize *= 2;
+						continue;
+					}
+
+					batchTimes.push_back(chrono::duration<double, nano>(batchTime).count() / batchSize);
+				}
+
+				sort(batchTimes.begin(), batchTimes.end());
+				double fastest = batchTimes.front();
+				double median = batchTimes[batchTimes.size() / 2];
+
+				output << "{\"name\":\"" << name << "\",\"parameters\":{";
+				for (auto parameter = parameters.begin(); parameter != parameters.end(); parameter++)
+				{
+					if (parameter != parameters.begin())
+					{
+						output << ",";
+					}
+
+					output << "\"" << parameter->first << "\":" << parameter->second;
+				}
+				output << "},\"iterations\":" << iterations << ",\"fastestNanoseconds\":" << fastest <<
+						",\"medianNanoseconds\":" << median << "}" << endl;
+			}
+		}
+	}
+}
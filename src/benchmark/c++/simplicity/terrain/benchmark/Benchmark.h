@@ -0,0 +1,47 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace benchmark
+		{
+			// Times operations and writes one line of JSON per result, so runs can be compared by scripts.
+			class Benchmark
+			{
+				public:
+					Benchmark(std::ostream& output, std::chrono::milliseconds minimumDuration);
+
+					// Repeats the operation until the minimum duration has passed. The parameters are written with the
+					// result to tell apart runs of the same operation.
+					void run(const std::string& name, const std::map<std::string, unsigned int>& parameters,
+							 const std::function<void()>& operation);
+
+				private:
+					std::chrono::milliseconds minimumDuration;
+
+					std::ostream& output;
+			};
+		}
+	}
+}
+
+#endif //BENCHMARK_H
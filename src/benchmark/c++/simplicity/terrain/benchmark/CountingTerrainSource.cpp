@@ -0,0 +1,74 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include "CountingTerrainSource.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace benchmark
+		{
+			CountingTerrainSource::CountingTerrainSource(const TerrainSource& source) :
+				sectionCount(0),
+				source(source)
+			{
+			}
+
+			void CountingTerrainSource::getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+												   unsigned int lodIndex, float* heights, unsigned int heightStride,
+												   Vector3* normals, unsigned int normalStride,
+												   TerrainScratch& scratch) const
+			{
+				sectionCount++;
+				source.getSection(sectionNorthWest, sectionSize, lodIndex, heights, heightStride, normals,
+								  normalStride, scratch);
+			}
+
+			unsigned int CountingTerrainSource::getSectionCount() const
+			{
+				return sectionCount;
+			}
+
+			vector<float> CountingTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest,
+																   const Vector2ui& sectionSize,
+																   unsigned int lodIndex) const
+			{
+				return source.getSectionHeights(sectionNorthWest, sectionSize, lodIndex);
+			}
+
+			void CountingTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest,
+														  const Vector2ui& sectionSize, unsigned int lodIndex,
+														  float* heights, unsigned int stride,
+														  TerrainScratch& scratch) const
+			{
+				source.getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heights, stride, scratch);
+			}
+
+			vector<Vector3> CountingTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest,
+																	 const Vector2ui& sectionSize,
+																	 unsigned int lodIndex) const
+			{
+				return source.getSectionNormals(sectionNorthWest, sectionSize, lodIndex);
+			}
+
+			void CountingTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest,
+														  const Vector2ui& sectionSize, unsigned int lodIndex,
+														  Vector3* normals, unsigned int stride,
+														  TerrainScratch& scratch) const
+			{
+				source.getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normals, stride, scratch);
+			}
+		}
+	}
+}
@@ -0,0 +1,64 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef COUNTINGTERRAINSOURCE_H
+#define COUNTINGTERRAINSOURCE_H
+
+#include <atomic>
+
+#include <simplicity/terrain/TerrainSource.h>
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace benchmark
+		{
+			// Passes queries on to another source, counting the sections read whole. Streamers read a chunk's
+			// vertices as one section, so this counts the chunks they build, whichever thread builds them.
+			class CountingTerrainSource : public TerrainSource
+			{
+				public:
+					CountingTerrainSource(const TerrainSource& source);
+
+					unsigned int getSectionCount() const;
+
+					void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									unsigned int lodIndex, float* heights, unsigned int heightStride,
+									Vector3* normals, unsigned int normalStride,
+									TerrainScratch& scratch) const override;
+
+					std::vector<float> getSectionHeights(const Vector2i& sectionNorthWest,
+														 const Vector2ui& sectionSize,
+														 unsigned int lodIndex) const override;
+
+					void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+										   unsigned int lodIndex, float* heights, unsigned int stride,
+										   TerrainScratch& scratch) const override;
+
+					std::vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest,
+														   const Vector2ui& sectionSize,
+														   unsigned int lodIndex) const override;
+
+					void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+										   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+										   TerrainScratch& scratch) const override;
+
+				private:
+					mutable std::atomic<unsigned int> sectionCount;
+
+					const TerrainSource& source;
+			};
+		}
+	}
+}
+
+#endif //COUNTINGTERRAINSOURCE_H
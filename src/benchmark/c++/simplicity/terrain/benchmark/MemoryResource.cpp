@@ -0,0 +1,224 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+
+#include "MemoryResource.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace benchmark
+		{
+			namespace
+			{
+				class AppendBuffer : public streambuf
+				{
+					public:
+						AppendBuffer(string& data) :
+							data(data)
+						{
+						}
+
+					protected:
+						int_type overflow(int_type character) override
+						{
+							if (!traits_type::eq_int_type(character, traits_type::eof()))
+							{
+								data.push_back(traits_type::to_char_type(character));
+							}
+
+							return character;
+						}
+
+						streamsize xsputn(const char* characters, streamsize count) override
+						{
+							data.append(characters, static_cast<size_t>(count));
+							return count;
+						}
+
+					private:
+						string& data;
+				};
+
+				// Has no get area of its own so reads see data appended after the stream was opened.
+				class ViewBuffer : public streambuf
+				{
+					public:
+						ViewBuffer(const string& data, atomic<unsigned long long>& bytesRead) :
+							bytesRead(bytesRead),
+							data(data),
+							position(0)
+						{
+						}
+
+					protected:
+						pos_type seekoff(off_type offset, ios_base::seekdir direction, ios_base::openmode) override
+						{
+							off_type origin = 0;
+							if (direction == ios_base::cur)
+							{
+								origin = static_cast<off_type>(position);
+							}
+							else if (direction == ios_base::end)
+							{
+								origin = static_cast<off_type>(data.size());
+							}
+
+							off_type target = origin + offset;
+							if (target < 0 || target > static_cast<off_type>(data.size()))
+							{
+								return pos_type(off_type(-1));
+							}
+
+							position = static_cast<size_t>(target);
+							return pos_type(target);
+						}
+
+						pos_type seekpos(pos_type position, ios_base::openmode mode) override
+						{
+							return seekoff(off_type(position), ios_base::beg, mode);
+						}
+
+						streamsize showmanyc() override
+						{
+							return static_cast<streamsize>(data.size() - min(position, data.size()));
+						}
+
+						int_type uflow() override
+						{
+							int_type character = underflow();
+							if (!traits_type::eq_int_type(character, traits_type::eof()))
+							{
+								bytesRead++;
+								position++;
+							}
+
+							return character;
+						}
+
+						int_type underflow() override
+						{
+							if (position >= data.size())
+							{
+								return traits_type::eof();
+							}
+
+							return traits_type::to_int_type(data[position]);
+						}
+
+						streamsize xsgetn(char* characters, streamsize count) override
+						{
+							size_t size = min(static_cast<size_t>(count), data.size() - min(position, data.size()));
+							data.copy(characters, size, position);
+							bytesRead += size;
+							position += size;
+
+							return static_cast<streamsize>(size);
+						}
+
+					private:
+						atomic<unsigned long long>& bytesRead;
+
+						const string& data;
+
+						size_t position;
+				};
+
+				class AppendStream : public ostream
+				{
+					public:
+						AppendStream(string& data) :
+							ostream(nullptr),
+							buffer(data)
+						{
+							rdbuf(&buffer);
+						}
+
+					private:
+						AppendBuffer buffer;
+				};
+
+				class ViewStream : public istream
+				{
+					public:
+						ViewStream(const string& data, atomic<unsigned long long>& bytesRead) :
+							istream(nullptr),
+							buffer(data, bytesRead)
+						{
+							rdbuf(&buffer);
+						}
+
+					private:
+						ViewBuffer buffer;
+				};
+			}
+
+			MemoryResource::MemoryResource(const string& name) :
+				Resource(Category::UNCATEGORIZED, name, true),
+				bytesRead(0),
+				data()
+			{
+			}
+
+			void MemoryResource::appendData(const char* data, unsigned int size)
+			{
+				this->data.append(data, size);
+			}
+
+			void MemoryResource::appendData(const string& data)
+			{
+				this->data.append(data);
+			}
+
+			unsigned long long MemoryResource::getBytesRead() const
+			{
+				return bytesRead;
+			}
+
+			string MemoryResource::getData() const
+			{
+				return data;
+			}
+
+			unique_ptr<istream> MemoryResource::getInputStream() const
+			{
+				return unique_ptr<istream>(new ViewStream(data, bytesRead));
+			}
+
+			unique_ptr<ostream> MemoryResource::getOutputStream()
+			{
+				return unique_ptr<ostream>(new AppendStream(data));
+			}
+
+			string MemoryResource::getUri() const
+			{
+				return "memory://" + getName();
+			}
+
+			void MemoryResource::setData(const char* data, unsigned int size)
+			{
+				this->data.assign(data, size);
+			}
+
+			void MemoryResource::setData(const string& data)
+			{
+				this->data = data;
+			}
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef MEMORYRESOURCE_H
+#define MEMORYRESOURCE_H
+
+#include <atomic>
+
+#include <simplicity/resources/Resource.h>
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace benchmark
+		{
+			// Keeps its data in memory so benchmarks do not measure the file system.
+			class MemoryResource : public Resource
+			{
+				public:
+					MemoryResource(const std::string& name = "memory");
+
+					void appendData(const char* data, unsigned int size) override;
+
+					void appendData(const std::string& data) override;
+
+					// The bytes read through all of its input streams, which may be read from any thread.
+					unsigned long long getBytesRead() const;
+
+					std::string getData() const override;
+
+					// Reads the data in place rather than from a copy of it, the resource must outlive the stream.
+					std::unique_ptr<std::istream> getInputStream() const override;
+
+					// Appends to the data.
+					std::unique_ptr<std::ostream> getOutputStream() override;
+
+					std::string getUri() const override;
+
+					void setData(const char* data, unsigned int size) override;
+
+					void setData(const std::string& data) override;
+
+				private:
+					mutable std::atomic<unsigned long long> bytesRead;
+
+					std::string data;
+			};
+		}
+	}
+}
+
+#endif //MEMORYRESOURCE_H
@@ -16,10 +16,23 @@
  */
 
 // Core
+#include "CachingTerrainSource.h"
+#include "ChunkCuller.h"
+#include "ChunkLoader.h"
 #include "LevelOfDetail.h"
+#include "MappedTerrainSource.h"
+#include "ProceduralTerrainSource.h"
 #include "ResourceTerrainSource.h"
+#include "StreamingStats.h"
+#include "TerrainCodec.h"
 #include "TerrainFactory.h"
+#include "TerrainHeightField.h"
+#include "TerrainLayout.h"
+#include "TerrainMetadata.h"
+#include "TerrainPalette.h"
+#include "TerrainScratch.h"
 #include "TerrainSource.h"
 
 // Scripting
+#include "scripting/QuadtreeTerrainStreamer.h"
 #include "scripting/TerrainStreamer.h"
@@ -0,0 +1,296 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include "CachingTerrainSource.h"
+#include "TerrainCodec.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		CachingTerrainSource::CachingTerrainSource(unique_ptr<TerrainSource> source, size_t budget) :
+			budget(budget),
+			entries(),
+			evictionCount(0),
+			hitCount(0),
+			index(),
+			missCount(0),
+			mutex(),
+			size(0),
+			source(move(source))
+		{
+		}
+
+		bool CachingTerrainSource::find(const Key& key, char* destination, unsigned int stride) const
+		{
+			lock_guard<std::mutex> lock(mutex);
+
+			auto iterator = index.find(key);
+			if (iterator == index.end())
+			{
+				missCount++;
+				return false;
+			}
+
+			// Most recently used first.
+			entries.splice(entries.begin(), entries, iterator->second);
+			hitCount++;
+
+			const Entry& entry = *iterator->second;
+			if (key.normals)
+			{
+				TerrainCodec::copySamples(reinterpret_cast<const char*>(entry.normals.data()), entry.normals.size(),
+										  sizeof(Vector3), destination, stride);
+			}
+			else
+			{
+				TerrainCodec::copySamples(reinterpret_cast<const char*>(entry.heights.data()), entry.heights.size(),
+										  sizeof(float), destination, stride);
+			}
+
+			return true;
+		}
+
+		size_t CachingTerrainSource::getBudget() const
+		{
+			return budget;
+		}
+
+		unsigned long CachingTerrainSource::getEvictionCount() const
+		{
+			lock_guard<std::mutex> lock(mutex);
+			return evictionCount;
+		}
+
+		unsigned long CachingTerrainSource::getHitCount() const
+		{
+			lock_guard<std::mutex> lock(mutex);
+			return hitCount;
+		}
+
+		unsigned long CachingTerrainSource::getMissCount() const
+		{
+			lock_guard<std::mutex> lock(mutex);
+			return missCount;
+		}
+
+		void CachingTerrainSource::getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											  unsigned int lodIndex, float* heights, unsigned int heightStride,
+											  Vector3* normals, unsigned int normalStride,
+											  TerrainScratch& scratch) const
+		{
+			Entry heightEntry;
+			heightEntry.key.lodIndex = lodIndex;
+			heightEntry.key.normals = false;
+			heightEntry.key.sectionNorthWest = sectionNorthWest;
+			heightEntry.key.sectionSize = sectionSize;
+
+			Entry normalEntry;
+			normalEntry.key = heightEntry.key;
+			normalEntry.key.normals = true;
+
+			bool heightsFound = find(heightEntry.key, reinterpret_cast<char*>(heights), heightStride);
+			bool normalsFound = find(normalEntry.key, reinterpret_cast<char*>(normals), normalStride);
+
+			if (heightsFound && normalsFound)
+			{
+				return;
+			}
+
+			size_t sampleCount = static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1));
+
+			// Both are read in one query when both are missing.
+			if (!heightsFound && !normalsFound)
+			{
+				heightEntry.heights.resize(sampleCount);
+				normalEntry.normals.resize(sampleCount);
+				source->getSection(sectionNorthWest, sectionSize, lodIndex, heightEntry.heights.data(), sizeof(float),
+								   normalEntry.normals.data(), sizeof(Vector3), scratch);
+			}
+			else if (!heightsFound)
+			{
+				heightEntry.heights.resize(sampleCount);
+				source->getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heightEntry.heights.data(),
+										  sizeof(float), scratch);
+			}
+			else
+			{
+				normalEntry.normals.resize(sampleCount);
+				source->getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normalEntry.normals.data(),
+										  sizeof(Vector3), scratch);
+			}
+
+			if (!heightsFound)
+			{
+				heightEntry.size = sampleCount * sizeof(float);
+				TerrainCodec::copySamples(reinterpret_cast<const char*>(heightEntry.heights.data()), sampleCount,
+										  sizeof(float), reinterpret_cast<char*>(heights), heightStride);
+				insert(move(heightEntry));
+			}
+
+			if (!normalsFound)
+			{
+				normalEntry.size = sampleCount * sizeof(Vector3);
+				TerrainCodec::copySamples(reinterpret_cast<const char*>(normalEntry.normals.data()), sampleCount,
+										  sizeof(Vector3), reinterpret_cast<char*>(normals), normalStride);
+				insert(move(normalEntry));
+			}
+		}
+
+		vector<float> CachingTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest,
+															  const Vector2ui& sectionSize,
+															  unsigned int lodIndex) const
+		{
+			vector<float> heightMap(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			TerrainScratch scratch;
+
+			getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heightMap.data(), sizeof(float), scratch);
+
+			return heightMap;
+		}
+
+		void CachingTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													 unsigned int lodIndex, float* heights, unsigned int stride,
+													 TerrainScratch& scratch) const
+		{
+			Entry entry;
+			entry.key.lodIndex = lodIndex;
+			entry.key.normals = false;
+			entry.key.sectionNorthWest = sectionNorthWest;
+			entry.key.sectionSize = sectionSize;
+
+			if (find(entry.key, reinterpret_cast<char*>(heights), stride))
+			{
+				return;
+			}
+
+			entry.heights.resize(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			source->getSectionHeights(sectionNorthWest, sectionSize, lodIndex, entry.heights.data(), sizeof(float),
+									  scratch);
+			entry.size = entry.heights.size() * sizeof(float);
+
+			TerrainCodec::copySamples(reinterpret_cast<const char*>(entry.heights.data()), entry.heights.size(),
+									  sizeof(float), reinterpret_cast<char*>(heights), stride);
+
+			insert(move(entry));
+		}
+
+		vector<Vector3> CachingTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest,
+																const Vector2ui& sectionSize,
+																unsigned int lodIndex) const
+		{
+			vector<Vector3> normalMap(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			TerrainScratch scratch;
+
+			getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normalMap.data(), sizeof(Vector3), scratch);
+
+			return normalMap;
+		}
+
+		void CachingTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													 unsigned int lodIndex, Vector3* normals, unsigned int stride,
+													 TerrainScratch& scratch) const
+		{
+			Entry entry;
+			entry.key.lodIndex = lodIndex;
+			entry.key.normals = true;
+			entry.key.sectionNorthWest = sectionNorthWest;
+			entry.key.sectionSize = sectionSize;
+
+			if (find(entry.key, reinterpret_cast<char*>(normals), stride))
+			{
+				return;
+			}
+
+			entry.normals.resize(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			source->getSectionNormals(sectionNorthWest, sectionSize, lodIndex, entry.normals.data(), sizeof(Vector3),
+									  scratch);
+			entry.size = entry.normals.size() * sizeof(Vector3);
+
+			TerrainCodec::copySamples(reinterpret_cast<const char*>(entry.normals.data()), entry.normals.size(),
+									  sizeof(Vector3), reinterpret_cast<char*>(normals), stride);
+
+			insert(move(entry));
+		}
+
+		size_t CachingTerrainSource::getSize() const
+		{
+			lock_guard<std::mutex> lock(mutex);
+			return size;
+		}
+
+		void CachingTerrainSource::insert(Entry&& entry) const
+		{
+			if (entry.size > budget)
+			{
+				return;
+			}
+
+			lock_guard<std::mutex> lock(mutex);
+
+			// Another thread may have read the same section while this one was.
+			if (index.find(entry.key) != index.end())
+			{
+				return;
+			}
+
+			while (size + entry.size > budget)
+			{
+				size -= entries.back().size;
+				index.erase(entries.back().key);
+				entries.pop_back();
+				evictionCount++;
+			}
+
+			// The section's samples are moved into the cache rather than copied.
+			entries.push_front(move(entry));
+			index[entries.front().key] = entries.begin();
+			size += entries.front().size;
+		}
+
+		void CachingTerrainSource::resetCounts()
+		{
+			lock_guard<std::mutex> lock(mutex);
+
+			evictionCount = 0;
+			hitCount = 0;
+			missCount = 0;
+		}
+
+		bool CachingTerrainSource::Key::operator<(const Key& other) const
+		{
+			if (lodIndex != other.lodIndex)
+			{
+				return lodIndex < other.lodIndex;
+			}
+			if (normals != other.normals)
+			{
+				return normals < other.normals;
+			}
+			if (sectionNorthWest.X() != other.sectionNorthWest.X())
+			{
+				return sectionNorthWest.X() < other.sectionNorthWest.X();
+			}
+			if (sectionNorthWest.Y() != other.sectionNorthWest.Y())
+			{
+				return sectionNorthWest.Y() < other.sectionNorthWest.Y();
+			}
+			if (sectionSize.X() != other.sectionSize.X())
+			{
+				return sectionSize.X() < other.sectionSize.X();
+			}
+
+			return sectionSize.Y() < other.sectionSize.Y();
+		}
+	}
+}
@@ -0,0 +1,113 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef CACHINGTERRAINSOURCE_H
+#define CACHINGTERRAINSOURCE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+
+#include "TerrainSource.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		class CachingTerrainSource : public TerrainSource
+		{
+			public:
+				CachingTerrainSource(std::unique_ptr<TerrainSource> source, std::size_t budget);
+
+				std::size_t getBudget() const;
+
+				unsigned long getEvictionCount() const;
+
+				unsigned long getHitCount() const;
+
+				unsigned long getMissCount() const;
+
+				// Caches the heights and normals separately, so a section can be found by any of the queries.
+				void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize, unsigned int lodIndex,
+								float* heights, unsigned int heightStride, Vector3* normals, unsigned int normalStride,
+								TerrainScratch& scratch) const override;
+
+				std::vector<float> getSectionHeights(const Vector2i& sectionNorthWest,
+													 const Vector2ui& sectionSize,
+													 unsigned int lodIndex) const override;
+
+				void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, float* heights, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
+				std::vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest,
+													   const Vector2ui& sectionSize,
+													   unsigned int lodIndex) const override;
+
+				void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
+				std::size_t getSize() const;
+
+				void resetCounts();
+
+			private:
+				struct Key
+				{
+					unsigned int lodIndex;
+
+					bool normals;
+
+					Vector2i sectionNorthWest;
+
+					Vector2ui sectionSize;
+
+					bool operator<(const Key& other) const;
+				};
+
+				struct Entry
+				{
+					std::vector<float> heights;
+
+					Key key;
+
+					std::vector<Vector3> normals;
+
+					std::size_t size;
+				};
+
+				std::size_t budget;
+
+				mutable std::list<Entry> entries;
+
+				mutable unsigned long evictionCount;
+
+				mutable unsigned long hitCount;
+
+				mutable std::map<Key, std::list<Entry>::iterator> index;
+
+				mutable unsigned long missCount;
+
+				mutable std::mutex mutex;
+
+				mutable std::size_t size;
+
+				std::unique_ptr<TerrainSource> source;
+
+				bool find(const Key& key, char* destination, unsigned int stride) const;
+
+				void insert(Entry&& entry) const;
+		};
+	}
+}
+
+#endif //CACHINGTERRAINSOURCE_H
@@ -0,0 +1,190 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ChunkCuller.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace
+		{
+			const float TWO_PI = 6.28318530718f;
+		}
+
+		ChunkCuller::ChunkCuller(unsigned int sectorCount) :
+			candidates(),
+			culledCount(0),
+			frustum(),
+			horizon(sectorCount),
+			occluders(),
+			sectorCount(sectorCount)
+		{
+		}
+
+		void ChunkCuller::cull(const Vector3& eye, const vector<TerrainChunk*>& chunks)
+		{
+			candidates.clear();
+			for (TerrainChunk* chunk : chunks)
+			{
+				if (chunk->getModel() == nullptr)
+				{
+					continue;
+				}
+
+				const TerrainChunk::Bounds& bounds = chunk->getBounds();
+				float nearestX = max(max(bounds.minimum.X() - eye.X(), eye.X() - bounds.maximum.X()), 0.0f);
+				float nearestZ = max(max(bounds.minimum.Z() - eye.Z(), eye.Z() - bounds.maximum.Z()), 0.0f);
+				float farthestX = max(abs(bounds.minimum.X() - eye.X()), abs(bounds.maximum.X() - eye.X()));
+				float farthestZ = max(abs(bounds.minimum.Z() - eye.Z()), abs(bounds.maximum.Z() - eye.Z()));
+
+				Candidate candidate;
+				candidate.chunk = chunk;
+				candidate.farthestDistance = sqrt(farthestX * farthestX + farthestZ * farthestZ);
+				candidate.nearestDistance = sqrt(nearestX * nearestX + nearestZ * nearestZ);
+				candidates.push_back(candidate);
+			}
+
+			// Front to back, so every chunk that can hide another has been seen before it.
+			sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+			{
+				return a.nearestDistance < b.nearestDistance;
+			});
+
+			fill(horizon.begin(), horizon.end(), numeric_limits<float>::lowest());
+			occluders.clear();
+			culledCount = 0;
+
+			float sectorsPerRadian = sectorCount / TWO_PI;
+
+			for (const Candidate& candidate : candidates)
+			{
+				// An occluder only hides what is entirely beyond it.
+				while (!occluders.empty() && occluders.front().distance <= candidate.nearestDistance)
+				{
+					const Occluder& occluder = occluders.front();
+					for (int sector = occluder.firstSector; sector <= occluder.lastSector; sector++)
+					{
+						float& elevation = horizon[(sector % sectorCount + sectorCount) % sectorCount];
+						elevation = max(elevation, occluder.elevation);
+					}
+
+					pop_heap(occluders.begin(), occluders.end());
+					occluders.pop_back();
+				}
+
+				const TerrainChunk::Bounds& bounds = candidate.chunk->getBounds();
+				bool visible = isInFrustum(bounds);
+
+				// The eye is above the chunk, it can neither be hidden nor hide anything.
+				if (candidate.nearestDistance == 0.0f)
+				{
+					candidate.chunk->getModel()->setVisible(visible);
+					continue;
+				}
+
+				float centerAngle = atan2((bounds.minimum.Z() + bounds.maximum.Z()) * 0.5f - eye.Z(),
+										  (bounds.minimum.X() + bounds.maximum.X()) * 0.5f - eye.X());
+				float firstAngle = centerAngle;
+				float lastAngle = centerAngle;
+				for (unsigned int corner = 0; corner < 4; corner++)
+				{
+					float x = (corner % 2 == 0 ? bounds.minimum.X() : bounds.maximum.X()) - eye.X();
+					float z = (corner / 2 == 0 ? bounds.minimum.Z() : bounds.maximum.Z()) - eye.Z();
+					float angle = remainder(atan2(z, x) - centerAngle, TWO_PI);
+
+					firstAngle = min(firstAngle, centerAngle + angle);
+					lastAngle = max(lastAngle, centerAngle + angle);
+				}
+
+				// The steepest line from the eye to any part of the chunk.
+				float top = bounds.maximum.Y() - eye.Y();
+				float topElevation = top / (top > 0.0f ? candidate.nearestDistance : candidate.farthestDistance);
+
+				int firstSector = static_cast<int>(floor(firstAngle * sectorsPerRadian));
+				int lastSector = static_cast<int>(floor(lastAngle * sectorsPerRadian));
+				if (visible)
+				{
+					visible = false;
+					for (int sector = firstSector; sector <= lastSector; sector++)
+					{
+						if (topElevation >= horizon[(sector % sectorCount + sectorCount) % sectorCount])
+						{
+							visible = true;
+							break;
+						}
+					}
+				}
+
+				candidate.chunk->getModel()->setVisible(visible);
+				if (!visible)
+				{
+					culledCount++;
+				}
+
+				// The chunk's lowest point hides the lines below it in the directions that cross it completely.
+				float bottom = bounds.minimum.Y() - eye.Y();
+
+				Occluder occluder;
+				occluder.distance = candidate.farthestDistance;
+				occluder.elevation =
+					bottom / (bottom > 0.0f ? candidate.farthestDistance : candidate.nearestDistance);
+				occluder.firstSector = static_cast<int>(ceil(firstAngle * sectorsPerRadian));
+				occluder.lastSector = static_cast<int>(floor(lastAngle * sectorsPerRadian)) - 1;
+
+				if (occluder.firstSector <= occluder.lastSector)
+				{
+					occluders.push_back(occluder);
+					push_heap(occluders.begin(), occluders.end());
+				}
+			}
+		}
+
+		unsigned int ChunkCuller::getCulledCount() const
+		{
+			return culledCount;
+		}
+
+		bool ChunkCuller::isInFrustum(const TerrainChunk::Bounds& bounds) const
+		{
+			for (const Vector4& plane : frustum)
+			{
+				// The corner furthest along the plane's normal.
+				float x = plane.X() >= 0.0f ? bounds.maximum.X() : bounds.minimum.X();
+				float y = plane.Y() >= 0.0f ? bounds.maximum.Y() : bounds.minimum.Y();
+				float z = plane.Z() >= 0.0f ? bounds.maximum.Z() : bounds.minimum.Z();
+
+				if (plane.X() * x + plane.Y() * y + plane.Z() * z + plane.W() < 0.0f)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void ChunkCuller::setFrustum(const vector<Vector4>& frustum)
+		{
+			this->frustum = frustum;
+		}
+
+		bool ChunkCuller::Occluder::operator<(const Occluder& other) const
+		{
+			return distance > other.distance;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef CHUNKCULLER_H
+#define CHUNKCULLER_H
+
+#include <vector>
+
+#include "TerrainChunk.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// Hides the chunks outside a view frustum and the chunks below the horizon formed by the chunks in front of
+		// them. Both tests are conservative, a chunk is only hidden when none of it can be seen.
+		class ChunkCuller
+		{
+			public:
+				// The horizon is kept for sectorCount directions around the eye.
+				ChunkCuller(unsigned int sectorCount = 256);
+
+				// Sets the visibility of every chunk that has a model.
+				void cull(const Vector3& eye, const std::vector<TerrainChunk*>& chunks);
+
+				// The number of chunks hidden by the last cull.
+				unsigned int getCulledCount() const;
+
+				// The planes face into the frustum, a point is inside when plane.X() * x + plane.Y() * y +
+				// plane.Z() * z + plane.W() >= 0 for every plane. No planes disables frustum culling.
+				void setFrustum(const std::vector<Vector4>& frustum);
+
+			private:
+				struct Candidate
+				{
+					TerrainChunk* chunk;
+
+					float farthestDistance;
+
+					float nearestDistance;
+				};
+
+				// The elevation below which a range of sectors is hidden beyond a distance.
+				struct Occluder
+				{
+					float distance;
+
+					float elevation;
+
+					int firstSector;
+
+					int lastSector;
+
+					// Nearer occluders compare greater so they are at the front of the heap.
+					bool operator<(const Occluder& other) const;
+				};
+
+				std::vector<Candidate> candidates;
+
+				unsigned int culledCount;
+
+				std::vector<Vector4> frustum;
+
+				std::vector<float> horizon;
+
+				std::vector<Occluder> occluders;
+
+				unsigned int sectorCount;
+
+				bool isInFrustum(const TerrainChunk::Bounds& bounds) const;
+		};
+	}
+}
+
+#endif //CHUNKCULLER_H
@@ -0,0 +1,182 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include "ChunkLoader.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		ChunkLoader::ChunkLoader(const TerrainSource& source, unsigned int workerCount) :
+			condition(),
+			mutex(),
+			pendingCount(0),
+			requests(),
+			results(),
+			source(source),
+			spareCompactVertices(),
+			spareVertices(),
+			stopping(false),
+			workers()
+		{
+			for (unsigned int index = 0; index < workerCount; index++)
+			{
+				workers.push_back(thread(&ChunkLoader::work, this));
+			}
+		}
+
+		ChunkLoader::~ChunkLoader()
+		{
+			{
+				lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+
+			condition.notify_all();
+
+			for (thread& worker : workers)
+			{
+				worker.join();
+			}
+		}
+
+		unsigned int ChunkLoader::getPendingCount() const
+		{
+			lock_guard<std::mutex> lock(mutex);
+			return pendingCount;
+		}
+
+		void ChunkLoader::load(const Request& request)
+		{
+			{
+				lock_guard<std::mutex> lock(mutex);
+
+				// A request that has not been started yet is superseded by a new request of the same kind for the same
+				// chunk.
+				for (auto iterator = requests.begin(); iterator != requests.end(); iterator++)
+				{
+					if (iterator->x == request.x && iterator->y == request.y && iterator->prefetch == request.prefetch)
+					{
+						requests.erase(iterator);
+						pendingCount--;
+						break;
+					}
+				}
+
+				requests.push_back(request);
+				pendingCount++;
+			}
+
+			condition.notify_one();
+		}
+
+		bool ChunkLoader::poll(Result& result)
+		{
+			lock_guard<std::mutex> lock(mutex);
+
+			if (results.empty())
+			{
+				return false;
+			}
+
+			if (result.compactVertices.vertices.capacity() > 0)
+			{
+				spareCompactVertices.push_back(move(result.compactVertices.vertices));
+			}
+
+			if (result.vertices.capacity() > 0)
+			{
+				spareVertices.push_back(move(result.vertices));
+			}
+
+			result = move(results.front());
+			results.pop_front();
+			pendingCount--;
+
+			if (result.exception != nullptr)
+			{
+				rethrow_exception(result.exception);
+			}
+
+			return true;
+		}
+
+		void ChunkLoader::work()
+		{
+			// Each worker reads through its own.
+			TerrainScratch scratch;
+
+			while (true)
+			{
+				Result result;
+
+				{
+					unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [this]() { return stopping || !requests.empty(); });
+
+					if (stopping)
+					{
+						return;
+					}
+
+					result.request = requests.front();
+					requests.pop_front();
+
+					if (result.request.compact && !spareCompactVertices.empty())
+					{
+						result.compactVertices.vertices = move(spareCompactVertices.back());
+						spareCompactVertices.pop_back();
+					}
+					else if (!result.request.compact && !spareVertices.empty())
+					{
+						result.vertices = move(spareVertices.back());
+						spareVertices.pop_back();
+					}
+				}
+
+				const Request& request = result.request;
+				TerrainChunk chunk(request.sectionSize.X(), request.scale);
+				chunk.setPalette(request.palette);
+
+				try
+				{
+					if (request.compact)
+					{
+						result.compactVertices.maximumHeight = request.maximumHeight;
+						result.compactVertices.minimumHeight = request.minimumHeight;
+						chunk.fillVertices(source, request.sectionNorthWest, request.lodIndex, result.compactVertices,
+										   scratch);
+					}
+					else
+					{
+						// The vertices are finished here so committing them is a copy.
+						unsigned int samples = request.sectionSize.X() + 1;
+						result.vertices.resize(samples * samples);
+						chunk.fillVertices(request.chunkNorthWest, source, request.sectionNorthWest, request.lodIndex,
+										   result.vertices.data(), scratch);
+					}
+				}
+				catch (...)
+				{
+					// The worker carries on, the caller decides what a failed load means.
+					result.exception = current_exception();
+				}
+
+				{
+					lock_guard<std::mutex> lock(mutex);
+					results.push_back(move(result));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,118 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef CHUNKLOADER_H
+#define CHUNKLOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "TerrainChunk.h"
+#include "TerrainSource.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		class ChunkLoader
+		{
+			public:
+				struct Request
+				{
+					Vector2i chunkNorthWest;
+
+					// Builds compact vertices quantized within the height range rather than full vertices.
+					bool compact;
+
+					unsigned int generation;
+
+					unsigned int lodIndex;
+
+					float maximumHeight;
+
+					float minimumHeight;
+
+					std::shared_ptr<const TerrainPalette> palette;
+
+					// Prefetches are staged by the caller rather than replacing the chunk.
+					bool prefetch;
+
+					float scale;
+
+					Vector2i sectionNorthWest;
+
+					Vector2ui sectionSize;
+
+					unsigned int x;
+
+					unsigned int y;
+				};
+
+				// Holds either full or compact vertices, as the request asked for.
+				struct Result
+				{
+					TerrainChunk::CompactVertices compactVertices;
+
+					// Thrown by the source while loading, rethrown by poll.
+					std::exception_ptr exception;
+
+					Request request;
+
+					std::vector<Vertex> vertices;
+				};
+
+				ChunkLoader(const TerrainSource& source, unsigned int workerCount);
+
+				~ChunkLoader();
+
+				ChunkLoader(const ChunkLoader&) = delete;
+
+				ChunkLoader& operator=(const ChunkLoader&) = delete;
+
+				unsigned int getPendingCount() const;
+
+				void load(const Request& request);
+
+				// The vertex buffers already held by the result are kept for a later request, so callers that poll into
+				// the same result every frame stop the loader allocating once it has warmed up. A load that failed is
+				// rethrown here on the calling thread, after its request has been put in the result.
+				bool poll(Result& result);
+
+			private:
+				std::condition_variable condition;
+
+				mutable std::mutex mutex;
+
+				unsigned int pendingCount;
+
+				std::deque<Request> requests;
+
+				std::deque<Result> results;
+
+				const TerrainSource& source;
+
+				std::vector<std::vector<TerrainChunk::CompactVertex>> spareCompactVertices;
+
+				std::vector<std::vector<Vertex>> spareVertices;
+
+				bool stopping;
+
+				std::vector<std::thread> workers;
+
+				void work();
+		};
+	}
+}
+
+#endif //CHUNKLOADER_H
@@ -0,0 +1,289 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedTerrainSource.h"
+#include "TerrainCodec.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		MappedTerrainSource::MappedTerrainSource(const Vector2ui& mapSize, const string& fileName,
+												 const vector<LevelOfDetail>& lods) :
+			data(nullptr),
+			layout(mapSize, lods),
+			size(0)
+		{
+			map(fileName);
+		}
+
+		MappedTerrainSource::MappedTerrainSource(const string& fileName, const TerrainLayout& layout) :
+			data(nullptr),
+			layout(layout),
+			size(0)
+		{
+			map(fileName);
+		}
+
+		void MappedTerrainSource::map(const string& fileName)
+		{
+#ifdef _WIN32
+			HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+									  FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				throw runtime_error("Failed to open terrain file: " + fileName);
+			}
+
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file, &fileSize);
+			size = static_cast<size_t>(fileSize.QuadPart);
+
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (mapping == nullptr)
+			{
+				throw runtime_error("Failed to map terrain file: " + fileName);
+			}
+
+			// The view keeps the mapping alive.
+			data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+			if (data == nullptr)
+			{
+				throw runtime_error("Failed to map terrain file: " + fileName);
+			}
+#else
+			int file = open(fileName.c_str(), O_RDONLY);
+			if (file == -1)
+			{
+				throw runtime_error("Failed to open terrain file: " + fileName);
+			}
+
+			struct stat fileStatus;
+			fstat(file, &fileStatus);
+			size = static_cast<size_t>(fileStatus.st_size);
+
+			// The mapping outlives the file descriptor.
+			void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+			close(file);
+			if (mapping == MAP_FAILED)
+			{
+				throw runtime_error("Failed to map terrain file: " + fileName);
+			}
+
+			data = static_cast<const char*>(mapping);
+#endif
+
+			if (size < layout.getSize())
+			{
+				unmap();
+				throw runtime_error("Terrain file is smaller than the map described: " + fileName);
+			}
+		}
+
+		MappedTerrainSource::~MappedTerrainSource()
+		{
+			unmap();
+		}
+
+		void MappedTerrainSource::copySection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+											  unsigned int lodIndex, TerrainLayout::Component component,
+											  char* destination, unsigned int destinationStride,
+											  TerrainScratch& scratch) const
+		{
+			if (layout.getEncoding() != TerrainLayout::Encoding::FLOAT)
+			{
+				auto readTile = [this](size_t offset, size_t)
+				{
+					return data + offset;
+				};
+
+				TerrainCodec::decodeSection(layout, lodIndex, sectionNorthWest, sectionSamples, component, readTile,
+											destination, destinationStride, scratch);
+				return;
+			}
+
+			unsigned int stride = layout.getStride(component);
+
+			layout.getBlocks(lodIndex, sectionNorthWest, sectionSamples, component, destinationStride, scratch.blocks,
+							 scratch.regions);
+
+			for (const TerrainLayout::Block& block : scratch.blocks)
+			{
+				char* blockDestination = destination + block.destinationOffset;
+				const char* source = data + block.offset;
+
+				if (destinationStride == stride && block.rowSize == block.rowStride &&
+					block.rowSize == block.destinationRowStride)
+				{
+					memcpy(blockDestination, source, block.rowSize * block.rows);
+					continue;
+				}
+
+				for (unsigned int row = 0; row < block.rows; row++)
+				{
+					TerrainCodec::copySamples(source, block.rowSize / stride, stride, blockDestination,
+											  destinationStride);
+
+					blockDestination += block.destinationRowStride;
+					source += block.rowStride;
+				}
+			}
+		}
+
+		const float* MappedTerrainSource::getHeights(unsigned int lodIndex) const
+		{
+			if (layout.getType() != TerrainLayout::Type::LINEAR)
+			{
+				throw runtime_error("Only the heights of a linear layout can be viewed directly.");
+			}
+
+			return reinterpret_cast<const float*>(data + layout.getHeightOffset(lodIndex));
+		}
+
+		const Vector3* MappedTerrainSource::getNormals(unsigned int lodIndex) const
+		{
+			if (layout.getType() != TerrainLayout::Type::LINEAR ||
+				layout.getNormals() != TerrainLayout::Normals::STORED)
+			{
+				throw runtime_error("Only the stored normals of a linear layout can be viewed directly.");
+			}
+
+			return reinterpret_cast<const Vector3*>(data + layout.getNormalOffset(lodIndex));
+		}
+
+		void MappedTerrainSource::getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											 unsigned int lodIndex, float* heights, unsigned int heightStride,
+											 Vector3* normals, unsigned int normalStride, TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+
+			if (layout.getNormals() == TerrainLayout::Normals::DERIVED)
+			{
+				// The heights are copied out of the apron copied for the normals rather than being decoded again.
+				auto readHeights = [&](const Vector2i& northWest, const Vector2ui& samples, float* apronHeights)
+				{
+					copySection(northWest, samples, lodIndex, TerrainLayout::Component::HEIGHTS,
+								reinterpret_cast<char*>(apronHeights), sizeof(float), scratch);
+
+					unsigned int west = sectionNorthWest.X() - northWest.X();
+					unsigned int north = sectionNorthWest.Y() - northWest.Y();
+					char* heightRow = reinterpret_cast<char*>(heights);
+
+					for (unsigned int row = 0; row < sectionSamples.Y(); row++)
+					{
+						TerrainCodec::copySamples(
+								reinterpret_cast<const char*>(&apronHeights[(row + north) * samples.X() + west]),
+								sectionSamples.X(), sizeof(float), heightRow, heightStride);
+
+						heightRow += sectionSamples.X() * heightStride;
+					}
+				};
+
+				TerrainCodec::deriveSectionNormals(layout, lodIndex, sectionNorthWest, sectionSamples, readHeights,
+												   normals, normalStride, scratch);
+				return;
+			}
+
+			copySection(sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::HEIGHTS,
+						reinterpret_cast<char*>(heights), heightStride, scratch);
+			copySection(sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::NORMALS,
+						reinterpret_cast<char*>(normals), normalStride, scratch);
+		}
+
+		vector<float> MappedTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest,
+															 const Vector2ui& sectionSize,
+															 unsigned int lodIndex) const
+		{
+			vector<float> heightMap(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			TerrainScratch scratch;
+
+			getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heightMap.data(), sizeof(float), scratch);
+
+			return heightMap;
+		}
+
+		void MappedTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													unsigned int lodIndex, float* heights, unsigned int stride,
+													TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+
+			copySection(sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::HEIGHTS,
+						reinterpret_cast<char*>(heights), stride, scratch);
+		}
+
+		vector<Vector3> MappedTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest,
+															   const Vector2ui& sectionSize,
+															   unsigned int lodIndex) const
+		{
+			vector<Vector3> normalMap(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			TerrainScratch scratch;
+
+			getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normalMap.data(), sizeof(Vector3), scratch);
+
+			return normalMap;
+		}
+
+		void MappedTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													unsigned int lodIndex, Vector3* normals, unsigned int stride,
+													TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+
+			if (layout.getNormals() == TerrainLayout::Normals::DERIVED)
+			{
+				auto readHeights = [&](const Vector2i& northWest, const Vector2ui& samples, float* heights)
+				{
+					copySection(northWest, samples, lodIndex, TerrainLayout::Component::HEIGHTS,
+								reinterpret_cast<char*>(heights), sizeof(float), scratch);
+				};
+
+				TerrainCodec::deriveSectionNormals(layout, lodIndex, sectionNorthWest, sectionSamples, readHeights,
+												   normals, stride, scratch);
+				return;
+			}
+
+			copySection(sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::NORMALS,
+						reinterpret_cast<char*>(normals), stride, scratch);
+		}
+
+		void MappedTerrainSource::unmap()
+		{
+			if (data == nullptr)
+			{
+				return;
+			}
+
+#ifdef _WIN32
+			UnmapViewOfFile(data);
+#else
+			munmap(const_cast<char*>(data), size);
+#endif
+			data = nullptr;
+		}
+	}
+}
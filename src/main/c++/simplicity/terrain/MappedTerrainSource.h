@@ -0,0 +1,85 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef MAPPEDTERRAINSOURCE_H
+#define MAPPEDTERRAINSOURCE_H
+
+#include <string>
+
+#include "LevelOfDetail.h"
+#include "TerrainLayout.h"
+#include "TerrainSource.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		class MappedTerrainSource : public TerrainSource
+		{
+			public:
+				MappedTerrainSource(const Vector2ui& mapSize, const std::string& fileName,
+									const std::vector<LevelOfDetail>& lods = {});
+
+				MappedTerrainSource(const std::string& fileName, const TerrainLayout& layout);
+
+				~MappedTerrainSource();
+
+				MappedTerrainSource(const MappedTerrainSource&) = delete;
+
+				MappedTerrainSource& operator=(const MappedTerrainSource&) = delete;
+
+				// Views of a whole level of detail in the mapping, for linear layouts. Linear layouts are never
+				// quantized, and the normals can only be viewed when they are stored.
+				const float* getHeights(unsigned int lodIndex) const;
+
+				const Vector3* getNormals(unsigned int lodIndex) const;
+
+				// Derives the normals from the heights it copies when they are not stored, rather than copying the
+				// heights twice.
+				void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize, unsigned int lodIndex,
+								float* heights, unsigned int heightStride, Vector3* normals, unsigned int normalStride,
+								TerrainScratch& scratch) const override;
+
+				std::vector<float> getSectionHeights(const Vector2i& sectionNorthWest,
+													 const Vector2ui& sectionSize,
+													 unsigned int lodIndex) const override;
+
+				void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, float* heights, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
+				std::vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest,
+													   const Vector2ui& sectionSize,
+													   unsigned int lodIndex) const override;
+
+				void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
+			private:
+				const char* data;
+
+				TerrainLayout layout;
+
+				std::size_t size;
+
+				void copySection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+								 unsigned int lodIndex, TerrainLayout::Component component,
+								 char* destination, unsigned int destinationStride, TerrainScratch& scratch) const;
+
+				void map(const std::string& fileName);
+
+				void unmap();
+		};
+	}
+}
+
+#endif //MAPPEDTERRAINSOURCE_H
@@ -0,0 +1,142 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include "ProceduralTerrainSource.h"
+#include "TerrainCodec.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		ProceduralTerrainSource::ProceduralTerrainSource(
+				function<TerrainFactory::HeightBlockFunction> heightBlockFunction, const vector<LevelOfDetail>& lods,
+				const Vector2ui& mapSize) :
+			heightBlockFunction(heightBlockFunction),
+			lods(lods),
+			mapSize(mapSize)
+		{
+			if (this->lods.size() == 0)
+			{
+				LevelOfDetail levelOfDetail;
+				levelOfDetail.layerCount = 1;
+				levelOfDetail.sampleFrequency = 1;
+				this->lods.push_back(levelOfDetail);
+			}
+		}
+
+		ProceduralTerrainSource::ProceduralTerrainSource(function<TerrainFactory::HeightFunction> heightFunction,
+														 const vector<LevelOfDetail>& lods, const Vector2ui& mapSize) :
+			ProceduralTerrainSource(TerrainFactory::toBlockFunction(heightFunction), lods, mapSize)
+		{
+		}
+
+		const float* ProceduralTerrainSource::generatePaddedHeights(const Vector2i& sectionNorthWest,
+																	const Vector2ui& sectionSamples,
+																	unsigned int lodIndex,
+																	TerrainScratch& scratch) const
+		{
+			Vector2ui paddedSamples(sectionSamples.X() + 2, sectionSamples.Y() + 2);
+			vector<float>& paddedHeights = scratch.paddedHeights;
+			paddedHeights.resize(paddedSamples.X() * paddedSamples.Y());
+
+			generateHeights(Vector2i(sectionNorthWest.X() - 1, sectionNorthWest.Y() - 1), paddedSamples, lodIndex,
+							paddedHeights.data());
+
+			return paddedHeights.data();
+		}
+
+		void ProceduralTerrainSource::generateHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+													  unsigned int lodIndex, float* heights) const
+		{
+			int frequency = lods[lodIndex].sampleFrequency;
+
+			// The function's x runs down the rows of a section, so the block it writes is laid out like the section.
+			Vector2i first(sectionNorthWest.Y() * frequency + static_cast<int>(mapSize.Y() / 2),
+						   sectionNorthWest.X() * frequency + static_cast<int>(mapSize.X() / 2));
+			heightBlockFunction(first, Vector2ui(sectionSamples.Y(), sectionSamples.X()), frequency, heights);
+		}
+
+		void ProceduralTerrainSource::getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+												 unsigned int lodIndex, float* heights, unsigned int heightStride,
+												 Vector3* normals, unsigned int normalStride,
+												 TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+			const float* paddedHeights = generatePaddedHeights(sectionNorthWest, sectionSamples, lodIndex, scratch);
+
+			unsigned int paddedWidth = sectionSamples.X() + 2;
+			for (unsigned int row = 0; row < sectionSamples.Y(); row++)
+			{
+				TerrainCodec::copySamples(reinterpret_cast<const char*>(&paddedHeights[(row + 1) * paddedWidth + 1]),
+										  sectionSamples.X(), sizeof(float),
+										  reinterpret_cast<char*>(heights) + row * sectionSamples.X() * heightStride,
+										  heightStride);
+			}
+
+			TerrainCodec::deriveNormals(paddedHeights, sectionSamples,
+										static_cast<float>(lods[lodIndex].sampleFrequency), normals, normalStride);
+		}
+
+		vector<float> ProceduralTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest,
+																 const Vector2ui& sectionSize,
+																 unsigned int lodIndex) const
+		{
+			vector<float> heightMap((sectionSize.X() + 1) * (sectionSize.Y() + 1));
+			TerrainScratch scratch;
+			getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heightMap.data(), sizeof(float), scratch);
+
+			return heightMap;
+		}
+
+		void ProceduralTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+														unsigned int lodIndex, float* heights,
+														unsigned int stride, TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+			if (stride == sizeof(float))
+			{
+				generateHeights(sectionNorthWest, sectionSamples, lodIndex, heights);
+				return;
+			}
+
+			vector<float>& heightMap = scratch.heights;
+			heightMap.resize(sectionSamples.X() * sectionSamples.Y());
+			generateHeights(sectionNorthWest, sectionSamples, lodIndex, heightMap.data());
+
+			TerrainCodec::copySamples(reinterpret_cast<const char*>(heightMap.data()), heightMap.size(),
+									  sizeof(float), reinterpret_cast<char*>(heights), stride);
+		}
+
+		vector<Vector3> ProceduralTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest,
+																   const Vector2ui& sectionSize,
+																   unsigned int lodIndex) const
+		{
+			vector<Vector3> normalMap((sectionSize.X() + 1) * (sectionSize.Y() + 1));
+			TerrainScratch scratch;
+			getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normalMap.data(), sizeof(Vector3), scratch);
+
+			return normalMap;
+		}
+
+		void ProceduralTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+														unsigned int lodIndex, Vector3* normals,
+														unsigned int stride, TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+			const float* paddedHeights = generatePaddedHeights(sectionNorthWest, sectionSamples, lodIndex, scratch);
+
+			TerrainCodec::deriveNormals(paddedHeights, sectionSamples,
+										static_cast<float>(lods[lodIndex].sampleFrequency), normals, stride);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef PROCEDURALTERRAINSOURCE_H
+#define PROCEDURALTERRAINSOURCE_H
+
+#include <functional>
+
+#include "LevelOfDetail.h"
+#include "TerrainFactory.h"
+#include "TerrainSource.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// Evaluates the height function for each section as it is read, so nothing is created beforehand and any
+		// section can be read, also those outside of the map.
+		class ProceduralTerrainSource : public TerrainSource
+		{
+			public:
+				// The function is called with the coordinates TerrainFactory would use for a map of mapSize, so the
+				// terrain matches one it creates from the same function. It is called from every thread that reads
+				// from the source, including a loader's workers, so it must be safe to do so.
+				ProceduralTerrainSource(std::function<TerrainFactory::HeightBlockFunction> heightBlockFunction,
+										const std::vector<LevelOfDetail>& lods = {},
+										const Vector2ui& mapSize = Vector2ui(0, 0));
+
+				ProceduralTerrainSource(std::function<TerrainFactory::HeightFunction> heightFunction,
+										const std::vector<LevelOfDetail>& lods = {},
+										const Vector2ui& mapSize = Vector2ui(0, 0));
+
+				// Evaluates the heights once for both.
+				void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize, unsigned int lodIndex,
+								float* heights, unsigned int heightStride, Vector3* normals, unsigned int normalStride,
+								TerrainScratch& scratch) const override;
+
+				std::vector<float> getSectionHeights(const Vector2i& sectionNorthWest,
+													 const Vector2ui& sectionSize,
+													 unsigned int lodIndex) const override;
+
+				void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, float* heights, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
+				// Derived from the heights around each sample.
+				std::vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest,
+													   const Vector2ui& sectionSize,
+													   unsigned int lodIndex) const override;
+
+				void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
+			private:
+				std::function<TerrainFactory::HeightBlockFunction> heightBlockFunction;
+
+				std::vector<LevelOfDetail> lods;
+
+				Vector2ui mapSize;
+
+				// Evaluates a section padded by a sample on every side, as the normals need, into the scratch.
+				const float* generatePaddedHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+												   unsigned int lodIndex, TerrainScratch& scratch) const;
+
+				void generateHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+									 unsigned int lodIndex, float* heights) const;
+		};
+	}
+}
+
+#endif //PROCEDURALTERRAINSOURCE_H
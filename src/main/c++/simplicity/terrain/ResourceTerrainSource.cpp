@@ -14,7 +14,10 @@
  * You should have received a copy of the GNU General Public License along with The Simplicity Engine. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+
 #include "ResourceTerrainSource.h"
+#include "TerrainCodec.h"
 
 using namespace std;
 
@@ -22,101 +25,254 @@ namespace simplicity
 {
 	namespace terrain
 	{
-		const unsigned int HEIGHT_STRIDE = sizeof(float);
-
-		const unsigned int NORMAL_STRIDE = sizeof(float) * 3;
-
 		ResourceTerrainSource::ResourceTerrainSource(const Vector2ui& mapSize, const Resource& resource,
 													 const vector<LevelOfDetail>& lods):
-			heightOffsets(),
-			lods(lods),
-			mapSize(mapSize),
-			normalOffsets(),
+			layout(mapSize, lods),
 			resource(resource)
 		{
-			if (lods.size() == 0)
-			{
-				heightOffsets.push_back(0);
+		}
+
+		ResourceTerrainSource::ResourceTerrainSource(const Resource& resource, const TerrainLayout& layout) :
+			layout(layout),
+			resource(resource)
+		{
+		}
 
-				unsigned int mapSamples = (mapSize.X() + 1) * (mapSize.Y() + 1);
-				normalOffsets.push_back(mapSamples * HEIGHT_STRIDE);
+		void ResourceTerrainSource::getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											   unsigned int lodIndex, float* heights, unsigned int heightStride,
+											   Vector3* normals, unsigned int normalStride,
+											   TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+			unique_ptr<istream> resourceStream = resource.getInputStream();
+
+			if (layout.getType() == TerrainLayout::Type::TILED &&
+				layout.getEncoding() == TerrainLayout::Encoding::FLOAT &&
+				layout.getNormals() == TerrainLayout::Normals::STORED)
+			{
+				readTiles(*resourceStream, sectionNorthWest, sectionSamples, lodIndex, heights, heightStride, normals,
+						  normalStride, scratch);
+				return;
 			}
-			else
+
+			if (layout.getNormals() == TerrainLayout::Normals::DERIVED)
 			{
-				unsigned int offset = 0;
-				for (LevelOfDetail lod : lods)
+				// The heights are copied out of the apron read for the normals rather than being decoded again.
+				auto readHeights = [&](const Vector2i& northWest, const Vector2ui& samples, float* apronHeights)
 				{
-					Vector2ui lodSize = mapSize / lod.sampleFrequency;
-					unsigned int lodSamples = (lodSize.X() + 1) * (lodSize.Y() + 1);
+					readSection(*resourceStream, northWest, samples, lodIndex, TerrainLayout::Component::HEIGHTS,
+								reinterpret_cast<char*>(apronHeights), sizeof(float), scratch);
 
-					heightOffsets.push_back(offset);
-					offset += lodSamples * HEIGHT_STRIDE;
-					normalOffsets.push_back(offset);
-					offset += lodSamples * NORMAL_STRIDE;
-				}
+					unsigned int west = sectionNorthWest.X() - northWest.X();
+					unsigned int north = sectionNorthWest.Y() - northWest.Y();
+					char* heightRow = reinterpret_cast<char*>(heights);
+
+					for (unsigned int row = 0; row < sectionSamples.Y(); row++)
+					{
+						TerrainCodec::copySamples(
+								reinterpret_cast<const char*>(&apronHeights[(row + north) * samples.X() + west]),
+								sectionSamples.X(), sizeof(float), heightRow, heightStride);
+
+						heightRow += sectionSamples.X() * heightStride;
+					}
+				};
+
+				TerrainCodec::deriveSectionNormals(layout, lodIndex, sectionNorthWest, sectionSamples, readHeights,
+												   normals, normalStride, scratch);
+				return;
 			}
+
+			readSection(*resourceStream, sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::HEIGHTS,
+						reinterpret_cast<char*>(heights), heightStride, scratch);
+			readSection(*resourceStream, sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::NORMALS,
+						reinterpret_cast<char*>(normals), normalStride, scratch);
 		}
 
 		vector<float> ResourceTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest,
 															   const Vector2ui& sectionSize,
 															   unsigned int lodIndex) const
 		{
-			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
-
-			vector<float> heightMap(static_cast<size_t>(sectionSamples.X() * sectionSamples.Y()));
+			vector<float> heightMap(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			TerrainScratch scratch;
 
-			readSection(sectionNorthWest, sectionSamples, lodIndex, heightOffsets[lodIndex], HEIGHT_STRIDE,
-						reinterpret_cast<char*>(heightMap.data()));
+			getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heightMap.data(), sizeof(float), scratch);
 
 			return heightMap;
 		}
 
+		void ResourceTerrainSource::getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													  unsigned int lodIndex, float* heights, unsigned int stride,
+													  TerrainScratch& scratch) const
+		{
+			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+			unique_ptr<istream> resourceStream = resource.getInputStream();
+
+			readSection(*resourceStream, sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::HEIGHTS,
+						reinterpret_cast<char*>(heights), stride, scratch);
+		}
+
 		vector<Vector3> ResourceTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest,
 																 const Vector2ui& sectionSize,
 																 unsigned int lodIndex) const
+		{
+			vector<Vector3> normalMap(static_cast<size_t>((sectionSize.X() + 1) * (sectionSize.Y() + 1)));
+			TerrainScratch scratch;
+
+			getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normalMap.data(), sizeof(Vector3), scratch);
+
+			return normalMap;
+		}
+
+		void ResourceTerrainSource::getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													  unsigned int lodIndex, Vector3* normals, unsigned int stride,
+													  TerrainScratch& scratch) const
 		{
 			Vector2ui sectionSamples(sectionSize.X() + 1, sectionSize.Y() + 1);
+			unique_ptr<istream> resourceStream = resource.getInputStream();
 
-			vector<Vector3> normalMap(static_cast<size_t>(sectionSamples.X() * sectionSamples.Y()));
+			readNormals(*resourceStream, sectionNorthWest, sectionSamples, lodIndex, normals, stride, scratch);
+		}
 
-			readSection(sectionNorthWest, sectionSamples, lodIndex, normalOffsets[lodIndex], NORMAL_STRIDE,
-						reinterpret_cast<char*>(normalMap.data()));
+		void ResourceTerrainSource::readNormals(istream& resourceStream, const Vector2i& sectionNorthWest,
+												const Vector2ui& sectionSamples, unsigned int lodIndex,
+												Vector3* normals, unsigned int stride, TerrainScratch& scratch) const
+		{
+			if (layout.getNormals() == TerrainLayout::Normals::DERIVED)
+			{
+				auto readHeights = [&](const Vector2i& northWest, const Vector2ui& samples, float* heights)
+				{
+					readSection(resourceStream, northWest, samples, lodIndex, TerrainLayout::Component::HEIGHTS,
+								reinterpret_cast<char*>(heights), sizeof(float), scratch);
+				};
 
-			return normalMap;
+				TerrainCodec::deriveSectionNormals(layout, lodIndex, sectionNorthWest, sectionSamples, readHeights,
+												   normals, stride, scratch);
+				return;
+			}
+
+			readSection(resourceStream, sectionNorthWest, sectionSamples, lodIndex, TerrainLayout::Component::NORMALS,
+						reinterpret_cast<char*>(normals), stride, scratch);
 		}
 
-		void ResourceTerrainSource::readSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
-												unsigned int lodIndex, unsigned int offset, unsigned int stride,
-												char* destination) const
+		void ResourceTerrainSource::readSection(istream& resourceStream, const Vector2i& sectionNorthWest,
+												const Vector2ui& sectionSamples, unsigned int lodIndex,
+												TerrainLayout::Component component, char* destination,
+												unsigned int destinationStride, TerrainScratch& scratch) const
 		{
-			Vector2ui lodSize = mapSize / lods[lodIndex].sampleFrequency;
+			vector<char>& tile = scratch.tile;
 
-			unsigned int resourceRowSize = (lodSize.X() + 1) * stride;
-			unsigned int sectionRowSize = sectionSamples.X() * stride;
+			if (layout.getEncoding() != TerrainLayout::Encoding::FLOAT)
+			{
+				auto readTile = [&resourceStream, &tile](size_t offset, size_t size)
+				{
+					tile.resize(size);
+					resourceStream.seekg(offset);
+					resourceStream.read(tile.data(), size);
 
-			Vector2i resourceNorthWest = toResourceSpace(lodIndex, sectionNorthWest);
-			unsigned int resourcePosition = offset +
-					resourceNorthWest.Y() * resourceRowSize + resourceNorthWest.X() * stride;
-			unique_ptr<istream> resourceStream = resource.getInputStream();
+					return tile.data();
+				};
+
+				TerrainCodec::decodeSection(layout, lodIndex, sectionNorthWest, sectionSamples, component, readTile,
+											destination, destinationStride, scratch);
+				return;
+			}
 
-			for (unsigned int row = 0; row < sectionSamples.Y(); row++)
+			unsigned int stride = layout.getStride(component);
+			bool packed = destinationStride == stride;
+
+			const vector<TerrainLayout::Block>& blocks = scratch.blocks;
+			layout.getBlocks(lodIndex, sectionNorthWest, sectionSamples, component, destinationStride, scratch.blocks,
+							 scratch.regions);
+
+			for (const TerrainLayout::Block& block : blocks)
 			{
-				resourceStream->seekg(resourcePosition);
-				resourceStream->read(&destination[row * sectionRowSize], sectionRowSize);
+				char* blockDestination = destination + block.destinationOffset;
+				unsigned int rowSamples = block.rowSize / stride;
 
-				resourcePosition += resourceRowSize;
+				if (packed && block.rowSize == block.rowStride && block.rowSize == block.destinationRowStride)
+				{
+					resourceStream.seekg(block.offset);
+					resourceStream.read(blockDestination, block.rowSize * block.rows);
+				}
+				else if (layout.getType() == TerrainLayout::Type::TILED)
+				{
+					// Tiles are small enough to read in one go and copy the rows out of.
+					tile.resize(block.rowStride * (block.rows - 1) + block.rowSize);
+					resourceStream.seekg(block.offset);
+					resourceStream.read(tile.data(), tile.size());
+
+					for (unsigned int row = 0; row < block.rows; row++)
+					{
+						TerrainCodec::copySamples(&tile[row * block.rowStride], rowSamples, stride,
+												  &blockDestination[row * block.destinationRowStride],
+												  destinationStride);
+					}
+				}
+				else
+				{
+					size_t resourcePosition = block.offset;
+					tile.resize(block.rowSize);
+
+					for (unsigned int row = 0; row < block.rows; row++)
+					{
+						char* rowDestination = &blockDestination[row * block.destinationRowStride];
+
+						resourceStream.seekg(resourcePosition);
+						resourceStream.read(packed ? rowDestination : tile.data(), block.rowSize);
+
+						if (!packed)
+						{
+							TerrainCodec::copySamples(tile.data(), rowSamples, stride, rowDestination,
+													  destinationStride);
+						}
+
+						resourcePosition += block.rowStride;
+					}
+				}
 			}
 		}
 
-		Vector2i ResourceTerrainSource::toResourceSpace(unsigned int lodIndex, const Vector2i& position) const
+		void ResourceTerrainSource::readTiles(istream& resourceStream, const Vector2i& sectionNorthWest,
+											  const Vector2ui& sectionSamples, unsigned int lodIndex, float* heights,
+											  unsigned int heightStride, Vector3* normals,
+											  unsigned int normalStride, TerrainScratch& scratch) const
 		{
-			Vector2ui lodSize = mapSize / lods[lodIndex].sampleFrequency;
+			unsigned int stride = layout.getStride(TerrainLayout::Component::HEIGHTS);
+			unsigned int normalSampleStride = layout.getStride(TerrainLayout::Component::NORMALS);
+
+			const vector<TerrainLayout::Block>& heightBlocks = scratch.blocks;
+			const vector<TerrainLayout::Block>& normalBlocks = scratch.normalBlocks;
+			vector<char>& tile = scratch.tile;
+			layout.getBlocks(lodIndex, sectionNorthWest, sectionSamples, TerrainLayout::Component::HEIGHTS,
+							 heightStride, scratch.blocks, scratch.regions);
+			layout.getBlocks(lodIndex, sectionNorthWest, sectionSamples, TerrainLayout::Component::NORMALS,
+							 normalStride, scratch.normalBlocks, scratch.regions);
+
+			for (unsigned int index = 0; index < heightBlocks.size(); index++)
+			{
+				const TerrainLayout::Block& heightBlock = heightBlocks[index];
+				const TerrainLayout::Block& normalBlock = normalBlocks[index];
 
-			Vector2i resourcePosition = position;
-			resourcePosition.X() += (lodSize.X() + 1) / 2;
-			resourcePosition.Y() += (lodSize.Y() + 1) / 2;
+				// A tile's normals follow its heights so both are read in one go.
+				size_t normalsStart = normalBlock.offset - heightBlock.offset;
+				tile.resize(normalsStart + normalBlock.rowStride * (normalBlock.rows - 1) + normalBlock.rowSize);
+				resourceStream.seekg(heightBlock.offset);
+				resourceStream.read(tile.data(), tile.size());
 
-			return resourcePosition;
+				char* heightDestination = reinterpret_cast<char*>(heights) + heightBlock.destinationOffset;
+				char* normalDestination = reinterpret_cast<char*>(normals) + normalBlock.destinationOffset;
+
+				for (unsigned int row = 0; row < heightBlock.rows; row++)
+				{
+					TerrainCodec::copySamples(&tile[row * heightBlock.rowStride], heightBlock.rowSize / stride, stride,
+											  &heightDestination[row * heightBlock.destinationRowStride],
+											  heightStride);
+					TerrainCodec::copySamples(&tile[normalsStart + row * normalBlock.rowStride],
+											  normalBlock.rowSize / normalSampleStride, normalSampleStride,
+											  &normalDestination[row * normalBlock.destinationRowStride],
+											  normalStride);
+				}
+			}
 		}
 	}
 }
@@ -20,6 +20,7 @@
 #include <simplicity/resources/Resource.h>
 
 #include "LevelOfDetail.h"
+#include "TerrainLayout.h"
 #include "TerrainSource.h"
 
 namespace simplicity
@@ -32,30 +33,47 @@ namespace simplicity
 				ResourceTerrainSource(const Vector2ui& mapSize, const Resource& resource,
 									  const std::vector<LevelOfDetail>& lods = {});
 
+				ResourceTerrainSource(const Resource& resource, const TerrainLayout& layout);
+
+				// Reads the heights and normals through a single stream.
+				void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize, unsigned int lodIndex,
+								float* heights, unsigned int heightStride, Vector3* normals, unsigned int normalStride,
+								TerrainScratch& scratch) const override;
+
 				std::vector<float> getSectionHeights(const Vector2i& sectionNorthWest,
 													 const Vector2ui& sectionSize,
 													 unsigned int lodIndex) const override;
 
+				void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, float* heights, unsigned int stride,
+									   TerrainScratch& scratch) const override;
+
 				std::vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest,
 													   const Vector2ui& sectionSize,
 													   unsigned int lodIndex) const override;
 
-			private:
-				std::vector<unsigned int> heightOffsets;
-
-				std::vector<LevelOfDetail> lods;
-
-				Vector2ui mapSize;
+				void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+									   TerrainScratch& scratch) const override;
 
-				std::vector<unsigned int> normalOffsets;
+			private:
+				TerrainLayout layout;
 
 				const Resource& resource;
 
-				void readSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
-								 unsigned int lodIndex, unsigned int offset, unsigned int stride,
-								 char* destination) const;
+				void readNormals(std::istream& resourceStream, const Vector2i& sectionNorthWest,
+								 const Vector2ui& sectionSamples, unsigned int lodIndex, Vector3* normals,
+								 unsigned int stride, TerrainScratch& scratch) const;
+
+				void readSection(std::istream& resourceStream, const Vector2i& sectionNorthWest,
+								 const Vector2ui& sectionSamples, unsigned int lodIndex,
+								 TerrainLayout::Component component, char* destination,
+								 unsigned int destinationStride, TerrainScratch& scratch) const;
 
-				Vector2i toResourceSpace(unsigned int lodIndex, const Vector2i& position) const;
+				void readTiles(std::istream& resourceStream, const Vector2i& sectionNorthWest,
+							   const Vector2ui& sectionSamples, unsigned int lodIndex, float* heights,
+							   unsigned int heightStride, Vector3* normals, unsigned int normalStride,
+							   TerrainScratch& scratch) const;
 		};
 	}
 }
@@ -0,0 +1,159 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include "StreamingStats.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace
+		{
+			thread_local StreamingStats::ScopedTimer* activeTimer = nullptr;
+		}
+
+		StreamingStats::StreamingStats(unsigned int lodCount) :
+			chunksPatched(0),
+			chunksRebuilt(0),
+			frame(),
+			lodBytesRead(lodCount),
+			previousTotal(),
+			residentChunkCount(0),
+			residentVertexBytes(0),
+			start(chrono::steady_clock::now()),
+			streamEvents(0),
+			times()
+		{
+			frame.lodBytesRead.resize(lodCount, 0);
+			previousTotal.lodBytesRead.resize(lodCount, 0);
+		}
+
+		void StreamingStats::addBytesRead(unsigned int lodIndex, unsigned long long byteCount)
+		{
+			lodBytesRead[lodIndex].fetch_add(byteCount, memory_order_relaxed);
+		}
+
+		void StreamingStats::addChunkPatched()
+		{
+			chunksPatched.fetch_add(1, memory_order_relaxed);
+		}
+
+		void StreamingStats::addChunkRebuilt()
+		{
+			chunksRebuilt.fetch_add(1, memory_order_relaxed);
+		}
+
+		void StreamingStats::addStreamEvent()
+		{
+			streamEvents.fetch_add(1, memory_order_relaxed);
+		}
+
+		void StreamingStats::addTime(Timer timer, const chrono::nanoseconds& time)
+		{
+			times[static_cast<unsigned int>(timer)].fetch_add(time.count(), memory_order_relaxed);
+		}
+
+		void StreamingStats::endFrame(unsigned int residentChunkCount, size_t residentVertexBytes)
+		{
+			this->residentChunkCount = residentChunkCount;
+			this->residentVertexBytes = residentVertexBytes;
+
+			Sample total = getTotal();
+
+			frame.chunksPatched = total.chunksPatched - previousTotal.chunksPatched;
+			frame.chunksRebuilt = total.chunksRebuilt - previousTotal.chunksRebuilt;
+			frame.duration = total.duration - previousTotal.duration;
+			for (unsigned int index = 0; index < total.lodBytesRead.size(); index++)
+			{
+				frame.lodBytesRead[index] = total.lodBytesRead[index] - previousTotal.lodBytesRead[index];
+			}
+			frame.patchTime = total.patchTime - previousTotal.patchTime;
+			frame.residentChunkCount = residentChunkCount;
+			frame.residentVertexBytes = residentVertexBytes;
+			frame.sourceTime = total.sourceTime - previousTotal.sourceTime;
+			frame.streamEvents = total.streamEvents - previousTotal.streamEvents;
+			frame.verticesTime = total.verticesTime - previousTotal.verticesTime;
+
+			previousTotal = move(total);
+		}
+
+		const StreamingStats::Sample& StreamingStats::getFrame() const
+		{
+			return frame;
+		}
+
+		StreamingStats::Sample StreamingStats::getTotal() const
+		{
+			Sample total;
+			total.chunksPatched = chunksPatched.load(memory_order_relaxed);
+			total.chunksRebuilt = chunksRebuilt.load(memory_order_relaxed);
+			total.duration = chrono::steady_clock::now() - start;
+			for (const atomic<unsigned long long>& byteCount : lodBytesRead)
+			{
+				total.lodBytesRead.push_back(byteCount.load(memory_order_relaxed));
+			}
+			total.patchTime =
+				chrono::nanoseconds(times[static_cast<unsigned int>(Timer::PATCH)].load(memory_order_relaxed));
+			total.residentChunkCount = residentChunkCount;
+			total.residentVertexBytes = residentVertexBytes;
+			total.sourceTime =
+				chrono::nanoseconds(times[static_cast<unsigned int>(Timer::SOURCE)].load(memory_order_relaxed));
+			total.streamEvents = streamEvents.load(memory_order_relaxed);
+			total.verticesTime =
+				chrono::nanoseconds(times[static_cast<unsigned int>(Timer::VERTICES)].load(memory_order_relaxed));
+
+			return total;
+		}
+
+		bool StreamingStats::isEnabled()
+		{
+#ifdef SIMPLE_TERRAIN_STATS
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		float StreamingStats::Sample::getStreamEventsPerSecond() const
+		{
+			if (duration.count() == 0)
+			{
+				return 0.0f;
+			}
+
+			return streamEvents / chrono::duration<float>(duration).count();
+		}
+
+		StreamingStats::ScopedTimer::ScopedTimer(StreamingStats& stats, Timer timer) :
+			nestedTime(0),
+			parent(activeTimer),
+			start(chrono::steady_clock::now()),
+			stats(stats),
+			timer(timer)
+		{
+			activeTimer = this;
+		}
+
+		StreamingStats::ScopedTimer::~ScopedTimer()
+		{
+			chrono::nanoseconds time = chrono::steady_clock::now() - start;
+			stats.addTime(timer, time - nestedTime);
+
+			if (parent != nullptr)
+			{
+				parent->nestedTime += time;
+			}
+			activeTimer = parent;
+		}
+	}
+}
@@ -0,0 +1,148 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef STREAMINGSTATS_H
+#define STREAMINGSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#ifdef SIMPLE_TERRAIN_STATS
+// A statement that only records stats, it is removed when they are compiled out.
+#define SIMPLE_TERRAIN_RECORD(statement) statement
+// Times the rest of the enclosing scope.
+#define SIMPLE_TERRAIN_TIME(stats, timer) simplicity::terrain::StreamingStats::ScopedTimer scopedTimer(stats, timer)
+#else
+#define SIMPLE_TERRAIN_RECORD(statement)
+#define SIMPLE_TERRAIN_TIME(stats, timer)
+#endif
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// Counts and times what streaming does, safe to record into from any thread. Nothing is recorded unless the
+		// library is built with SIMPLE_TERRAIN_STATS defined.
+		class StreamingStats
+		{
+			public:
+				struct Sample
+				{
+					unsigned long long chunksPatched;
+
+					unsigned long long chunksRebuilt;
+
+					// The time covered by the sample.
+					std::chrono::nanoseconds duration;
+
+					// The bytes of samples read from the source for each level of detail.
+					std::vector<unsigned long long> lodBytesRead;
+
+					std::chrono::nanoseconds patchTime;
+
+					// Chunks with a model, at the end of the sample.
+					unsigned int residentChunkCount;
+
+					// Meshes of the resident chunks, models kept for reuse and staged chunks, at the end of the sample.
+					std::size_t residentVertexBytes;
+
+					std::chrono::nanoseconds sourceTime;
+
+					// Moves of the streamed area to follow the target.
+					unsigned long long streamEvents;
+
+					std::chrono::nanoseconds verticesTime;
+
+					float getStreamEventsPerSecond() const;
+				};
+
+				enum class Timer
+				{
+					PATCH,
+					SOURCE,
+					VERTICES
+				};
+
+				// Nested timers on the same thread pause the ones around them, so time is never counted twice.
+				class ScopedTimer
+				{
+					public:
+						ScopedTimer(StreamingStats& stats, Timer timer);
+
+						ScopedTimer(const ScopedTimer& original) = delete;
+
+						~ScopedTimer();
+
+						ScopedTimer& operator=(const ScopedTimer& original) = delete;
+
+					private:
+						std::chrono::nanoseconds nestedTime;
+
+						ScopedTimer* parent;
+
+						std::chrono::steady_clock::time_point start;
+
+						StreamingStats& stats;
+
+						Timer timer;
+				};
+
+				StreamingStats(unsigned int lodCount);
+
+				void addBytesRead(unsigned int lodIndex, unsigned long long byteCount);
+
+				void addChunkPatched();
+
+				void addChunkRebuilt();
+
+				void addStreamEvent();
+
+				void addTime(Timer timer, const std::chrono::nanoseconds& time);
+
+				// Closes the current frame, the resident memory is measured by the caller.
+				void endFrame(unsigned int residentChunkCount, std::size_t residentVertexBytes);
+
+				// The last frame closed.
+				const Sample& getFrame() const;
+
+				// Everything recorded so far.
+				Sample getTotal() const;
+
+				// Whether the library was built to record stats.
+				static bool isEnabled();
+
+			private:
+				std::atomic<unsigned long long> chunksPatched;
+
+				std::atomic<unsigned long long> chunksRebuilt;
+
+				Sample frame;
+
+				std::vector<std::atomic<unsigned long long>> lodBytesRead;
+
+				Sample previousTotal;
+
+				unsigned int residentChunkCount;
+
+				std::size_t residentVertexBytes;
+
+				std::chrono::steady_clock::time_point start;
+
+				std::atomic<unsigned long long> streamEvents;
+
+				// Nanoseconds indexed by timer.
+				std::atomic<long long> times[3];
+		};
+	}
+}
+
+#endif //STREAMINGSTATS_H
@@ -14,6 +14,10 @@
  * You should have received a copy of the GNU General Public License along with The Simplicity Engine. If not, see
  * <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
 #include <simplicity/math/MathFunctions.h>
 #include <simplicity/model/ModelFactory.h>
 
@@ -25,12 +29,71 @@ namespace simplicity
 {
 	namespace terrain
 	{
+		namespace
+		{
+			const float NORMAL_QUANTUM = 32767.0f;
+
+			Vector3 decodeNormal(const int16_t* encoded)
+			{
+				float u = static_cast<float>(encoded[0]) / NORMAL_QUANTUM;
+				float v = static_cast<float>(encoded[1]) / NORMAL_QUANTUM;
+				float y = 1.0f - fabs(u) - fabs(v);
+
+				// The lower half of the octahedron is folded out over the corners.
+				if (y < 0.0f)
+				{
+					float foldedU = (1.0f - fabs(v)) * (u < 0.0f ? -1.0f : 1.0f);
+					float foldedV = (1.0f - fabs(u)) * (v < 0.0f ? -1.0f : 1.0f);
+					u = foldedU;
+					v = foldedV;
+				}
+
+				Vector3 normal(u, y, v);
+				normal.normalize();
+
+				return normal;
+			}
+
+			void encodeNormal(const Vector3& normal, int16_t* encoded)
+			{
+				float length = fabs(normal.X()) + fabs(normal.Y()) + fabs(normal.Z());
+				float u = normal.X() / length;
+				float v = normal.Z() / length;
+
+				if (normal.Y() < 0.0f)
+				{
+					float foldedU = (1.0f - fabs(v)) * (u < 0.0f ? -1.0f : 1.0f);
+					float foldedV = (1.0f - fabs(u)) * (v < 0.0f ? -1.0f : 1.0f);
+					u = foldedU;
+					v = foldedV;
+				}
+
+				encoded[0] = static_cast<int16_t>(round(u * NORMAL_QUANTUM));
+				encoded[1] = static_cast<int16_t>(round(v * NORMAL_QUANTUM));
+			}
+
+			const shared_ptr<const TerrainPalette>& getDefaultPalette()
+			{
+				static const shared_ptr<const TerrainPalette> defaultPalette(new TerrainPalette);
+
+				return defaultPalette;
+			}
+		}
+
 		TerrainChunk::TerrainChunk(unsigned int size, float scale) :
+			bounds(),
+			heightGrid(),
 			model(nullptr),
+			palette(getDefaultPalette()),
+			patches(),
 			samples(size + 1),
 			scale(scale),
 			size(size)
 		{
+			patches.east = 1;
+			patches.north = 1;
+			patches.south = 1;
+			patches.west = 1;
 		}
 
 		unique_ptr<Model> TerrainChunk::createModel()
@@ -59,52 +122,189 @@ namespace simplicity
 			return move(model);
 		}
 
-		float TerrainChunk::getHeight(const Vector3& position) const
+		void TerrainChunk::fillSurface(const Vector2i& mapNorthWest, const float* heights, const Vector3* normals,
+									   Vertex* vertices, TerrainScratch& scratch) const
 		{
-			Vector2i meshPosition = getMeshPosition(position);
+			// The samples are classified together and each vertex is then written once, a whole row at a time.
+			vector<float>& columnPositions = scratch.columnPositions;
+			vector<uint8_t>& materials = scratch.materials;
+			vector<float>& slopes = scratch.slopes;
+			columnPositions.resize(samples);
+			materials.resize(samples * samples);
+			slopes.resize(samples * samples);
+
+			for (unsigned int index = 0; index < samples * samples; index++)
+			{
+				slopes[index] = 1.0f - normals[index].Y();
+			}
+
+			palette->classify(heights, slopes.data(), samples * samples, materials.data());
 
-			if (meshPosition.X() < 0 || meshPosition.X() >= size ||
-				meshPosition.Y() < 0 || meshPosition.Y() >= size)
+			for (unsigned int column = 0; column < samples; column++)
 			{
-				return 0.0f;
+				columnPositions[column] = static_cast<float>(mapNorthWest.X()) + static_cast<float>(column) * scale;
 			}
 
-			float xLocal = fmod(position.X(), scale);
-			float zLocal = fmod(position.Z(), scale);
-			bool inFirstTriangle = xLocal < zLocal;
+			const vector<TerrainPalette::Band>& bands = palette->getBands();
+			for (unsigned int row = 0; row < samples; row++)
+			{
+				unsigned int rowStart = row * samples;
+				float rowPosition = static_cast<float>(mapNorthWest.Y()) + static_cast<float>(row) * scale;
 
-			const MeshData& meshData = model->getMesh()->getData();
+				for (unsigned int column = 0; column < samples; column++)
+				{
+					Vertex& vertex = vertices[rowStart + column];
+
+					vertex.color = bands[materials[rowStart + column]].color;
+					vertex.normal = normals[rowStart + column];
+					vertex.position = Vector3(columnPositions[column], heights[rowStart + column], rowPosition);
+				}
+			}
+		}
+
+		void TerrainChunk::fillVertices(const Vector2i& mapNorthWest, const vector<float>& heightMap,
+										const vector<Vector3>& normalMap, Vertex* vertices,
+										TerrainScratch& scratch) const
+		{
+			fillSurface(mapNorthWest, heightMap.data(), normalMap.data(), vertices, scratch);
+		}
+
+		void TerrainChunk::fillVertices(const Vector2i& mapNorthWest, const TerrainSource& source,
+										const Vector2i& sectionNorthWest, unsigned int lodIndex,
+										Vertex* vertices, TerrainScratch& scratch) const
+		{
+			// Read packed rather than straight into the vertices so the source can copy whole rows.
+			vector<float>& heightMap = scratch.sectionHeights;
+			vector<Vector3>& normalMap = scratch.sectionNormals;
+			heightMap.resize(samples * samples);
+			normalMap.resize(samples * samples);
+
+			source.getSection(sectionNorthWest, Vector2ui(size, size), lodIndex, heightMap.data(), sizeof(float),
+							  normalMap.data(), sizeof(Vector3), scratch);
+
+			fillSurface(mapNorthWest, heightMap.data(), normalMap.data(), vertices, scratch);
+		}
 
-			unsigned int baseVertexIndex = meshPosition.Y() * samples + meshPosition.X();
-			Vector3 pointA(0.0f, meshData.vertexData[baseVertexIndex].position.Y(), 0.0f);
-			Vector3 pointB;
-			Vector3 pointC;
-			if (inFirstTriangle)
+		void TerrainChunk::fillVertices(const TerrainSource& source, const Vector2i& sectionNorthWest,
+										unsigned int lodIndex, CompactVertices& vertices, TerrainScratch& scratch) const
+		{
+			vector<float>& heightMap = scratch.sectionHeights;
+			vector<uint8_t>& materials = scratch.materials;
+			vector<Vector3>& normalMap = scratch.sectionNormals;
+			vector<float>& slopes = scratch.slopes;
+			heightMap.resize(samples * samples);
+			materials.resize(samples * samples);
+			normalMap.resize(samples * samples);
+			slopes.resize(samples * samples);
+
+			source.getSection(sectionNorthWest, Vector2ui(size, size), lodIndex, heightMap.data(), sizeof(float),
+							  normalMap.data(), sizeof(Vector3), scratch);
+
+			for (unsigned int index = 0; index < samples * samples; index++)
 			{
-				pointB = Vector3(0.0f, meshData.vertexData[baseVertexIndex + samples].position.Y(), scale);
-				pointC = Vector3(scale, meshData.vertexData[baseVertexIndex + samples + 1].position.Y(), scale);
+				slopes[index] = 1.0f - normalMap[index].Y();
 			}
-			else
+
+			palette->classify(heightMap.data(), slopes.data(), samples * samples, materials.data());
+
+			float heightRange = vertices.maximumHeight - vertices.minimumHeight;
+			float heightQuantum = heightRange > 0.0f ? UINT16_MAX / heightRange : 0.0f;
+
+			vertices.vertices.resize(samples * samples);
+			for (unsigned int index = 0; index < samples * samples; index++)
 			{
-				pointB = Vector3(scale, meshData.vertexData[baseVertexIndex + samples + 1].position.Y(), scale);
-				pointC = Vector3(scale, meshData.vertexData[baseVertexIndex + 1].position.Y(), 0.0f);
+				CompactVertex& vertex = vertices.vertices[index];
+
+				float height = min(max(heightMap[index], vertices.minimumHeight), vertices.maximumHeight);
+
+				vertex.height = static_cast<uint16_t>(round((height - vertices.minimumHeight) * heightQuantum));
+				vertex.material = materials[index];
+				encodeNormal(normalMap[index], vertex.normal);
 			}
+		}
 
-			model->getMesh()->releaseData();
+		const TerrainChunk::Bounds& TerrainChunk::getBounds() const
+		{
+			return bounds;
+		}
+
+		float TerrainChunk::getHeight(const Vector3& position) const
+		{
+			float height = 0.0f;
+			getHeights(&position, 1, &height);
+
+			return height;
+		}
+
+		void TerrainChunk::getHeights(const Vector3* positions, unsigned int count, float* heights) const
+		{
+			if (heightGrid.empty())
+			{
+				fill(heights, heights + count, 0.0f);
+				return;
+			}
+
+			int lastCell = static_cast<int>(size) - 1;
+			float extent = static_cast<float>(size);
 
-			Vector3 edge0 = pointB - pointA;
-			Vector3 edge1 = pointC - pointA;
-			Vector3 normal = crossProduct(edge0, edge1);
-			normal.normalize();
+			// Positions outside the chunk are clamped to its edge cells and their heights zeroed afterwards, so every
+			// position reads the four corners of a cell in the grid the same way.
+			for (unsigned int index = 0; index < count; index++)
+			{
+				float x = positions[index].X() / scale;
+				float z = positions[index].Z() / scale;
+				float inside = x >= 0.0f && x < extent && z >= 0.0f && z < extent ? 1.0f : 0.0f;
+
+				int column = min(max(static_cast<int>(x), 0), lastCell);
+				int row = min(max(static_cast<int>(z), 0), lastCell);
+				float u = x - column;
+				float v = z - row;
+
+				const float* cell = &heightGrid[row * samples + column];
+				float northWest = cell[0];
+				float northEast = cell[1];
+				float southWest = cell[samples];
+				float southEast = cell[samples + 1];
+
+				// The cell is split into triangles along the diagonal from north west to south east.
+				bool inFirstTriangle = u < v;
+				float uSlope = inFirstTriangle ? southEast - southWest : northEast - northWest;
+				float vSlope = inFirstTriangle ? southWest - northWest : southEast - northEast;
+
+				heights[index] = inside * (northWest + u * uSlope + v * vSlope);
+			}
+		}
 
-			// Solve the equation for the plane (ax + by + cz + d = 0) to find y.
-			float ax = normal.X() * xLocal;
-			float b = normal.Y();
-			float cz = normal.Z() * zLocal;
-			float d = dotProduct(normal, pointA) * -1.0f;
-			float y = (ax + cz + d) / b * -1.0f;
+		const vector<unsigned int>& TerrainChunk::getIndices(unsigned int size, const Patches& patches)
+		{
+			static map<pair<unsigned int, Patches>, vector<unsigned int>> indexCache;
+			static mutex indexCacheMutex;
+
+			lock_guard<mutex> lock(indexCacheMutex);
 
-			return y;
+			vector<unsigned int>& indices = indexCache[make_pair(size, patches)];
+			if (indices.empty())
+			{
+				// The corners are shared by two edges, so the order the edges are patched in matters.
+				TerrainChunk chunk(size);
+				indices.resize(size * size * 6);
+				chunk.setIndices(indices.data());
+
+				pair<Edge, unsigned int> edges[] = {
+					make_pair(Edge::WEST, patches.west), make_pair(Edge::EAST, patches.east),
+					make_pair(Edge::NORTH, patches.north), make_pair(Edge::SOUTH, patches.south)
+				};
+
+				for (const pair<Edge, unsigned int>& edge : edges)
+				{
+					if (edge.second > 1)
+					{
+						chunk.patchIndices(indices.data(), edge.first, edge.second);
+					}
+				}
+			}
+
+			return indices;
 		}
 
 		Model* TerrainChunk::getModel()
@@ -117,6 +317,11 @@ namespace simplicity
 			return model;
 		}
 
+		const TerrainChunk::Patches& TerrainChunk::getPatches() const
+		{
+			return patches;
+		}
+
 		unsigned int TerrainChunk::getSize() const
 		{
 			return size;
@@ -124,8 +329,46 @@ namespace simplicity
 
 		void TerrainChunk::patch(Edge edge, unsigned int patchSize)
 		{
+			Patches patched = patches;
+
+			if (edge == Edge::EAST)
+			{
+				patched.east = patchSize;
+			}
+			else if (edge == Edge::NORTH)
+			{
+				patched.north = patchSize;
+			}
+			else if (edge == Edge::SOUTH)
+			{
+				patched.south = patchSize;
+			}
+			else
+			{
+				patched.west = patchSize;
+			}
+
+			patch(patched);
+		}
+
+		void TerrainChunk::patch(const Patches& patches)
+		{
+			if (patches == this->patches)
+			{
+				return;
+			}
+
+			this->patches = patches;
+
 			MeshData& meshData = model->getMesh()->getData(false);
 
+			setIndices(meshData);
+
+			model->getMesh()->releaseData();
+		}
+
+		void TerrainChunk::patchIndices(unsigned int* indices, Edge edge, unsigned int patchSize) const
+		{
 			if (edge == Edge::NORTH)
 			{
 				unsigned int patchCount = size / patchSize;
@@ -139,28 +382,28 @@ namespace simplicity
 					{
 						if (unitIndex <= (patchSize - 1) / 2)
 						{
-							meshData.indexData[baseIndex + unitIndex * 6] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6] = baseVertexIndex;
 
 							// Collapse second triangle.
-							meshData.indexData[baseIndex + unitIndex * 6 + 3] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 4] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 5] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 3] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 4] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 5] = baseVertexIndex;
 						}
 						else
 						{
-							meshData.indexData[baseIndex + unitIndex * 6] = baseVertexIndex + patchSize;
+							indices[baseIndex + unitIndex * 6] = baseVertexIndex + patchSize;
 
 							// Collapse second triangle.
-							meshData.indexData[baseIndex + unitIndex * 6 + 3] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 4] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 5] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 3] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 4] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 5] = baseVertexIndex;
 						}
 
 						if (unitIndex == (patchSize - 1) / 2)
 						{
-							meshData.indexData[baseIndex + unitIndex * 6 + 3] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 4] = baseVertexIndex + samples + unitIndex + 1;
-							meshData.indexData[baseIndex + unitIndex * 6 + 5] = baseVertexIndex + patchSize;
+							indices[baseIndex + unitIndex * 6 + 3] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 4] = baseVertexIndex + samples + unitIndex + 1;
+							indices[baseIndex + unitIndex * 6 + 5] = baseVertexIndex + patchSize;
 						}
 					}
 				}
@@ -180,28 +423,28 @@ namespace simplicity
 					{
 						if (unitIndex < patchSize / 2)
 						{
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex + 1;
+							indices[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex + 1;
 
 							// Collapse second triangle.
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 4] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 5] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 4] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 5] = baseVertexIndex;
 						}
 						else
 						{
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex + samples * patchSize + 1;
+							indices[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex + samples * patchSize + 1;
 
 							// Collapse second triangle.
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 4] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 5] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 4] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 5] = baseVertexIndex;
 						}
 
 						if (unitIndex == patchSize / 2)
 						{
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex + samples * unitIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 4] = baseVertexIndex + samples * patchSize + 1;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 5] = baseVertexIndex + 1;
+							indices[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex + samples * unitIndex;
+							indices[baseIndex + size * unitIndex * 6 + 4] = baseVertexIndex + samples * patchSize + 1;
+							indices[baseIndex + size * unitIndex * 6 + 5] = baseVertexIndex + 1;
 						}
 					}
 				}
@@ -222,27 +465,27 @@ namespace simplicity
 						if (unitIndex < patchSize / 2)
 						{
 							// Collapse first triangle.
-							meshData.indexData[baseIndex + unitIndex * 6] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 1] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 2] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 1] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 2] = baseVertexIndex;
 
-							meshData.indexData[baseIndex + unitIndex * 6 + 4] = baseVertexIndex + samples;
+							indices[baseIndex + unitIndex * 6 + 4] = baseVertexIndex + samples;
 						}
 						else
 						{
 							// Collapse first triangle.
-							meshData.indexData[baseIndex + unitIndex * 6] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 1] = baseVertexIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 2] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 1] = baseVertexIndex;
+							indices[baseIndex + unitIndex * 6 + 2] = baseVertexIndex;
 
-							meshData.indexData[baseIndex + unitIndex * 6 + 4] = baseVertexIndex + samples + patchSize;
+							indices[baseIndex + unitIndex * 6 + 4] = baseVertexIndex + samples + patchSize;
 						}
 
 						if (unitIndex == patchSize / 2)
 						{
-							meshData.indexData[baseIndex + unitIndex * 6] = baseVertexIndex + unitIndex;
-							meshData.indexData[baseIndex + unitIndex * 6 + 1] = baseVertexIndex + samples;
-							meshData.indexData[baseIndex + unitIndex * 6 + 2] = baseVertexIndex + samples + patchSize;
+							indices[baseIndex + unitIndex * 6] = baseVertexIndex + unitIndex;
+							indices[baseIndex + unitIndex * 6 + 1] = baseVertexIndex + samples;
+							indices[baseIndex + unitIndex * 6 + 2] = baseVertexIndex + samples + patchSize;
 						}
 					}
 				}
@@ -261,36 +504,56 @@ namespace simplicity
 						if (unitIndex <= (patchSize - 1) / 2)
 						{
 							// Collapse first triangle.
-							meshData.indexData[baseIndex + size * unitIndex * 6] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 1] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 1] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex;
 
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex;
 						}
 						else
 						{
 							// Collapse first triangle.
-							meshData.indexData[baseIndex + size * unitIndex * 6] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 1] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 1] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex;
 
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex + samples * patchSize;
+							indices[baseIndex + size * unitIndex * 6 + 3] = baseVertexIndex + samples * patchSize;
 						}
 
 						if (unitIndex == (patchSize - 1) / 2)
 						{
-							meshData.indexData[baseIndex + size * unitIndex * 6] = baseVertexIndex;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 1] = baseVertexIndex + samples * patchSize;
-							meshData.indexData[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex + samples * (unitIndex + 1) + 1;
+							indices[baseIndex + size * unitIndex * 6] = baseVertexIndex;
+							indices[baseIndex + size * unitIndex * 6 + 1] = baseVertexIndex + samples * patchSize;
+							indices[baseIndex + size * unitIndex * 6 + 2] = baseVertexIndex + samples * (unitIndex + 1) + 1;
 						}
 					}
 				}
 			}
+		}
 
-			model->getMesh()->releaseData();
+		void TerrainChunk::setHeights(const Vertex* vertices)
+		{
+			heightGrid.resize(samples * samples);
+			for (unsigned int index = 0; index < samples * samples; index++)
+			{
+				heightGrid[index] = vertices[index].position.Y();
+			}
+
+			auto heightBounds = minmax_element(heightGrid.begin(), heightGrid.end());
+
+			const Vertex& southEast = vertices[samples * samples - 1];
+			bounds.maximum = Vector3(southEast.position.X(), *heightBounds.second, southEast.position.Z());
+			bounds.minimum = Vector3(vertices[0].position.X(), *heightBounds.first, vertices[0].position.Z());
 		}
 
-		void TerrainChunk::setIndices(MeshData& meshData)
+		void TerrainChunk::setIndices(MeshData& meshData) const
+		{
+			const vector<unsigned int>& indices = getIndices(size, patches);
+
+			copy(indices.begin(), indices.end(), meshData.indexData);
+		}
+
+		void TerrainChunk::setIndices(unsigned int* indices) const
 		{
 			unsigned int index = 0;
 			for (unsigned int row = 0; row < size; row++)
@@ -299,61 +562,86 @@ namespace simplicity
 				{
 					unsigned int baseVertexIndex = row * samples + column;
 
-					meshData.indexData[index++] = baseVertexIndex;
-					meshData.indexData[index++] = baseVertexIndex + samples;
-					meshData.indexData[index++] = baseVertexIndex + samples + 1;
-					meshData.indexData[index++] = baseVertexIndex;
-					meshData.indexData[index++] = baseVertexIndex + samples + 1;
-					meshData.indexData[index++] = baseVertexIndex + 1;
+					indices[index++] = baseVertexIndex;
+					indices[index++] = baseVertexIndex + samples;
+					indices[index++] = baseVertexIndex + samples + 1;
+					indices[index++] = baseVertexIndex;
+					indices[index++] = baseVertexIndex + samples + 1;
+					indices[index++] = baseVertexIndex + 1;
 				}
 			}
 		}
 
+		void TerrainChunk::setModel(Model& model)
+		{
+			this->model = &model;
+
+			MeshData& meshData = model.getMesh()->getData(false);
+
+			setIndices(meshData);
+
+			model.getMesh()->releaseData();
+		}
+
+		void TerrainChunk::setPalette(shared_ptr<const TerrainPalette> palette)
+		{
+			this->palette = move(palette);
+		}
+
 		void TerrainChunk::setVertices(const Vector2i& mapNorthWest, const vector<float>& heightMap,
-									   const vector<Vector3>& normalMap)
+									   const vector<Vector3>& normalMap, TerrainScratch& scratch)
 		{
 			MeshData& meshData = model->getMesh()->getData(false);
 
+			fillVertices(mapNorthWest, heightMap, normalMap, meshData.vertexData, scratch);
+			setHeights(meshData.vertexData);
+
+			model->getMesh()->releaseData();
+		}
+
+		void TerrainChunk::setVertices(const Vector2i& mapNorthWest, const TerrainSource& source,
+									   const Vector2i& sectionNorthWest, unsigned int lodIndex, TerrainScratch& scratch)
+		{
+			MeshData& meshData = model->getMesh()->getData(false);
+
+			fillVertices(mapNorthWest, source, sectionNorthWest, lodIndex, meshData.vertexData, scratch);
+			setHeights(meshData.vertexData);
+
+			model->getMesh()->releaseData();
+		}
+
+		void TerrainChunk::setVertices(const Vector2i& mapNorthWest, const CompactVertices& vertices)
+		{
+			MeshData& meshData = model->getMesh()->getData(false);
+
+			float heightStep = (vertices.maximumHeight - vertices.minimumHeight) / UINT16_MAX;
+
 			for (unsigned int row = 0; row < samples; row++)
 			{
 				for (unsigned int column = 0; column < samples; column++)
 				{
+					const CompactVertex& compactVertex = vertices.vertices[row * samples + column];
 					Vertex& vertex = meshData.vertexData[row * samples + column];
 
-					vertex.normal = normalMap[row * samples + column];
-
-					vertex.position.X() = static_cast<float>(mapNorthWest.X()) + static_cast<float>(column) * scale;
-					vertex.position.Y() = heightMap[row * samples + column];
-					vertex.position.Z() = static_cast<float>(mapNorthWest.Y()) + static_cast<float>(row) * scale;
-
-					// Random
-					//vertex.color = Vector4(getRandomInt(0, 1), getRandomInt(0, 1), getRandomInt(0, 1), 1.0f);
+					vertex.color = palette->getColor(compactVertex.material);
+					vertex.normal = decodeNormal(compactVertex.normal);
+					vertex.position = Vector3(static_cast<float>(mapNorthWest.X()) + static_cast<float>(column) * scale,
+											  vertices.minimumHeight + compactVertex.height * heightStep,
+											  static_cast<float>(mapNorthWest.Y()) + static_cast<float>(row) * scale);
+				}
+			}
 
-					// Grass
-					vertex.color = Vector4(0.0f, 0.5f, 0.0f, 1.0f);
+			setHeights(meshData.vertexData);
 
-					// Snow
-					if (vertex.position.Y() > 60.0f)
-					{
-						vertex.color = Vector4(0.8f, 0.8f, 0.8f, 1.0f);
-					}
+			model->getMesh()->releaseData();
+		}
 
-					// Sand
-					if (vertex.position.Y() < 2.0f)
-					{
-						vertex.color = Vector4(0.83f, 0.65f, 0.15f, 1.0f);
-					}
+		void TerrainChunk::setVertices(const vector<Vertex>& vertices)
+		{
+			MeshData& meshData = model->getMesh()->getData(false);
 
-					// White borders
-					/*if (row == 0 ||
-						row == size ||
-						column == 0 ||
-						column == size)
-					{
-						vertex.color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
-					}*/
-				}
-			}
+			copy(vertices.begin(), vertices.end(), meshData.vertexData);
+			setHeights(meshData.vertexData);
 
 			model->getMesh()->releaseData();
 		}
@@ -363,5 +651,28 @@ namespace simplicity
 			return Vector2i(static_cast<int>(floor(worldPosition.X() / scale)),
 							static_cast<int>(floor(worldPosition.Z() / scale)));
 		}
+
+		bool TerrainChunk::Patches::operator==(const Patches& other) const
+		{
+			return east == other.east && north == other.north && south == other.south && west == other.west;
+		}
+
+		bool TerrainChunk::Patches::operator<(const Patches& other) const
+		{
+			if (east != other.east)
+			{
+				return east < other.east;
+			}
+			if (north != other.north)
+			{
+				return north < other.north;
+			}
+			if (south != other.south)
+			{
+				return south < other.south;
+			}
+
+			return west < other.west;
+		}
 	}
 }
@@ -17,8 +17,13 @@
 #ifndef TERRAINCHUNK_H_
 #define TERRAINCHUNK_H_
 
+#include <cstdint>
+
 #include <simplicity/model/Model.h>
 
+#include "TerrainPalette.h"
+#include "TerrainSource.h"
+
 namespace simplicity
 {
 	namespace terrain
@@ -26,6 +31,38 @@ namespace simplicity
 		class TerrainChunk
 		{
 			public:
+				// The world space box around the chunk's vertices.
+				struct Bounds
+				{
+					Vector3 maximum;
+
+					Vector3 minimum;
+				};
+
+				// A sample packed into eight bytes, its position is implied by its index in the chunk.
+				struct CompactVertex
+				{
+					// Spread over the range of heights of the vertices it belongs to.
+					std::uint16_t height;
+
+					// The palette band of the sample.
+					std::uint8_t material;
+
+					// Octahedral encoding of the normal.
+					std::int16_t normal[2];
+				};
+
+				// The heights are spread over a range set before the vertices are filled. Chunks that meet should share
+				// one, such as the range of the whole map or of a level of detail, so their edges meet too.
+				struct CompactVertices
+				{
+					float maximumHeight;
+
+					float minimumHeight;
+
+					std::vector<CompactVertex> vertices;
+				};
+
 				enum class Edge
 				{
 					EAST,
@@ -34,35 +71,109 @@ namespace simplicity
 					WEST
 				};
 
+				// The patch size of each edge, one leaves the edge as it is.
+				struct Patches
+				{
+					unsigned int east;
+
+					unsigned int north;
+
+					unsigned int south;
+
+					unsigned int west;
+
+					bool operator==(const Patches& other) const;
+
+					bool operator<(const Patches& other) const;
+				};
+
 				TerrainChunk(unsigned int size, float scale = 1.0f);
 
 				std::unique_ptr<Model> createModel();
 
+				// The buffers used along the way come from the scratch, as do those of the source's query.
+				void fillVertices(const Vector2i& mapNorthWest, const std::vector<float>& heightMap,
+								  const std::vector<Vector3>& normalMap, Vertex* vertices,
+								  TerrainScratch& scratch) const;
+
+				void fillVertices(const Vector2i& mapNorthWest, const TerrainSource& source,
+								  const Vector2i& sectionNorthWest, unsigned int lodIndex, Vertex* vertices,
+								  TerrainScratch& scratch) const;
+
+				// Packs the section into a fraction of the memory of the full vertices, for chunks that are held a
+				// while before they are used. Heights outside of the range of the vertices are clamped to it.
+				void fillVertices(const TerrainSource& source, const Vector2i& sectionNorthWest, unsigned int lodIndex,
+								  CompactVertices& vertices, TerrainScratch& scratch) const;
+
+				const Bounds& getBounds() const;
+
+				// The position is relative to the chunk, positions outside of it are zero.
 				float getHeight(const Vector3& position) const;
 
+				// Answers from a copy of the heights kept with the chunk, the mesh is not touched.
+				void getHeights(const Vector3* positions, unsigned int count, float* heights) const;
+
 				Model* getModel();
 
 				const Model* getModel() const;
 
 				Vector2i getMeshPosition(const Vector3& worldPosition) const;
 
+				const Patches& getPatches() const;
+
 				unsigned int getSize() const;
 
 				void patch(Edge edge, unsigned int patchSize);
 
+				void patch(const Patches& patches);
+
+				// Takes over the model of a chunk of the same size, resetting its indices.
+				void setModel(Model& model);
+
+				// Used by vertices filled after it is set, chunks use a grass, snow and sand palette by default.
+				void setPalette(std::shared_ptr<const TerrainPalette> palette);
+
 				void setVertices(const Vector2i& mapNorthWest, const std::vector<float>& heightMap,
-								 const std::vector<Vector3>& normalMap);
+								 const std::vector<Vector3>& normalMap, TerrainScratch& scratch);
+
+				void setVertices(const Vector2i& mapNorthWest, const TerrainSource& source,
+								 const Vector2i& sectionNorthWest, unsigned int lodIndex, TerrainScratch& scratch);
+
+				void setVertices(const Vector2i& mapNorthWest, const CompactVertices& vertices);
+
+				void setVertices(const std::vector<Vertex>& vertices);
 
 			private:
+				Bounds bounds;
+
+				std::vector<float> heightGrid;
+
 				Model* model;
 
+				std::shared_ptr<const TerrainPalette> palette;
+
+				Patches patches;
+
 				unsigned int samples;
 
 				float scale;
 
 				unsigned int size;
 
-				void setIndices(MeshData& meshData);
+				void fillSurface(const Vector2i& mapNorthWest, const float* heights, const Vector3* normals,
+								 Vertex* vertices, TerrainScratch& scratch) const;
+
+				// Chunks of the same size and patches share their indices, which are built the first time they are used.
+				static const std::vector<unsigned int>& getIndices(unsigned int size, const Patches& patches);
+
+				void patchIndices(unsigned int* indices, Edge edge, unsigned int patchSize) const;
+
+				// Keeps a copy of the heights for queries and bounds them.
+				void setHeights(const Vertex* vertices);
+
+				void setIndices(MeshData& meshData) const;
+
+				void setIndices(unsigned int* indices) const;
 		};
 	}
 }
@@ -0,0 +1,319 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "TerrainCodec.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace
+		{
+			// Written without branches so the loop vectorizes.
+			template<typename Encoded>
+			void decodeOctahedral(const Encoded* encodedNormals, unsigned int sampleCount, Vector3* normals)
+			{
+				const float maximum = numeric_limits<Encoded>::max();
+
+				for (unsigned int index = 0; index < sampleCount; index++)
+				{
+					float x = encodedNormals[index * 2] / maximum * 2.0f - 1.0f;
+					float z = encodedNormals[index * 2 + 1] / maximum * 2.0f - 1.0f;
+					float y = 1.0f - fabs(x) - fabs(z);
+
+					// Unfold the lower hemisphere.
+					float fold = max(-y, 0.0f);
+					x -= copysign(fold, x);
+					z -= copysign(fold, z);
+
+					float inverseLength = 1.0f / sqrt(x * x + y * y + z * z);
+
+					float* normal = normals[index].getData();
+					normal[0] = x * inverseLength;
+					normal[1] = y * inverseLength;
+					normal[2] = z * inverseLength;
+				}
+			}
+
+			// The octahedron's axis is y (up), so normals facing up get the most precision.
+			template<typename Encoded>
+			void encodeOctahedral(const Vector3* normals, unsigned int sampleCount, Encoded* encodedNormals)
+			{
+				const float maximum = numeric_limits<Encoded>::max();
+
+				for (unsigned int index = 0; index < sampleCount; index++)
+				{
+					const Vector3& normal = normals[index];
+
+					float sum = fabs(normal.X()) + fabs(normal.Y()) + fabs(normal.Z());
+					float u = normal.X() / sum;
+					float v = normal.Z() / sum;
+
+					if (normal.Y() < 0.0f)
+					{
+						float foldedU = copysign(1.0f - fabs(v), u);
+						float foldedV = copysign(1.0f - fabs(u), v);
+						u = foldedU;
+						v = foldedV;
+					}
+
+					encodedNormals[index * 2] = static_cast<Encoded>(lround((u * 0.5f + 0.5f) * maximum));
+					encodedNormals[index * 2 + 1] = static_cast<Encoded>(lround((v * 0.5f + 0.5f) * maximum));
+				}
+			}
+		}
+
+		void TerrainCodec::copySamples(const char* source, unsigned int sampleCount, unsigned int sampleSize,
+									   char* destination, unsigned int destinationStride)
+		{
+			if (destinationStride == sampleSize)
+			{
+				memcpy(destination, source, sampleCount * sampleSize);
+				return;
+			}
+
+			for (unsigned int index = 0; index < sampleCount; index++)
+			{
+				memcpy(destination + index * destinationStride, source + index * sampleSize, sampleSize);
+			}
+		}
+
+		void TerrainCodec::decodeHeights(const char* tile, unsigned int sampleCount, float* heights)
+		{
+			float minimum;
+			float scale;
+			memcpy(&minimum, tile, sizeof(float));
+			memcpy(&scale, tile + sizeof(float), sizeof(float));
+
+			const uint16_t* encodedHeights = reinterpret_cast<const uint16_t*>(tile + TerrainLayout::TILE_HEADER_SIZE);
+
+			for (unsigned int index = 0; index < sampleCount; index++)
+			{
+				heights[index] = minimum + static_cast<float>(encodedHeights[index]) * scale;
+			}
+		}
+
+		void TerrainCodec::decodeNormals(const uint8_t* encodedNormals, unsigned int sampleCount, Vector3* normals)
+		{
+			decodeOctahedral(encodedNormals, sampleCount, normals);
+		}
+
+		void TerrainCodec::decodeNormals(const uint16_t* encodedNormals, unsigned int sampleCount, Vector3* normals)
+		{
+			decodeOctahedral(encodedNormals, sampleCount, normals);
+		}
+
+		void TerrainCodec::decodeSection(const TerrainLayout& layout, unsigned int lodIndex,
+										 const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+										 TerrainLayout::Component component, const function<TileReader>& readTile,
+										 char* destination, unsigned int destinationStride, TerrainScratch& scratch)
+		{
+			unsigned int tileSamples = layout.getTileSamples(lodIndex);
+			unsigned int tileSampleCount = tileSamples * tileSamples;
+			unsigned int stride = component == TerrainLayout::Component::HEIGHTS ?
+					TerrainLayout::HEIGHT_STRIDE : TerrainLayout::NORMAL_STRIDE;
+
+			// Heights need the tile's header, normals can be read on their own.
+			size_t tileOffset = 0;
+			size_t tileSize = TerrainLayout::TILE_HEADER_SIZE + tileSampleCount * layout.getStride(component);
+			if (component == TerrainLayout::Component::NORMALS)
+			{
+				tileOffset = layout.getTileComponentOffset(lodIndex, component);
+				tileSize = tileSampleCount * layout.getStride(component);
+			}
+
+			vector<char>& decodedTile = scratch.decodedTile;
+			vector<TerrainLayout::TileRegion>& regions = scratch.regions;
+			layout.getTileRegions(lodIndex, sectionNorthWest, sectionSamples, regions);
+
+			for (const TerrainLayout::TileRegion& region : regions)
+			{
+				const char* tile = readTile(layout.getTileOffset(lodIndex, region.tile) + tileOffset, tileSize);
+
+				if (region.samples.X() == tileSamples && region.samples.Y() == tileSamples &&
+					sectionSamples.X() == tileSamples && sectionSamples.Y() == tileSamples &&
+					destinationStride == stride)
+				{
+					decodeTile(layout, component, tile, tileSampleCount, destination);
+					continue;
+				}
+
+				decodedTile.resize(tileSampleCount * stride);
+				decodeTile(layout, component, tile, tileSampleCount, decodedTile.data());
+
+				for (unsigned int row = 0; row < region.samples.Y(); row++)
+				{
+					unsigned int tileIndex = (region.tileNorthWest.Y() + row) * tileSamples + region.tileNorthWest.X();
+					unsigned int sectionIndex =
+							(region.sectionNorthWest.Y() + row) * sectionSamples.X() + region.sectionNorthWest.X();
+
+					copySamples(&decodedTile[tileIndex * stride], region.samples.X(), stride,
+								&destination[sectionIndex * destinationStride], destinationStride);
+				}
+			}
+		}
+
+		void TerrainCodec::decodeTile(const TerrainLayout& layout, TerrainLayout::Component component,
+									  const char* tile, unsigned int sampleCount, char* destination)
+		{
+			if (component == TerrainLayout::Component::HEIGHTS)
+			{
+				decodeHeights(tile, sampleCount, reinterpret_cast<float*>(destination));
+			}
+			else if (layout.getEncoding() == TerrainLayout::Encoding::QUANTIZED_8)
+			{
+				decodeNormals(reinterpret_cast<const uint8_t*>(tile), sampleCount,
+							  reinterpret_cast<Vector3*>(destination));
+			}
+			else
+			{
+				decodeNormals(reinterpret_cast<const uint16_t*>(tile), sampleCount,
+							  reinterpret_cast<Vector3*>(destination));
+			}
+		}
+
+		void TerrainCodec::deriveNormals(const float* paddedHeights, const Vector2ui& samples, float spacing,
+										 Vector3* normals, unsigned int normalStride)
+		{
+			unsigned int paddedWidth = samples.X() + 2;
+			float doubleSpacing = spacing * 2.0f;
+
+			for (unsigned int row = 0; row < samples.Y(); row++)
+			{
+				const float* north = &paddedHeights[row * paddedWidth + 1];
+				const float* west = &paddedHeights[(row + 1) * paddedWidth];
+				const float* east = west + 2;
+				const float* south = north + paddedWidth * 2;
+				char* normalRow = reinterpret_cast<char*>(normals) + row * samples.X() * normalStride;
+
+				// Central differences, written without branches so the loop vectorizes.
+				for (unsigned int column = 0; column < samples.X(); column++)
+				{
+					float x = west[column] - east[column];
+					float z = north[column] - south[column];
+					float inverseLength = 1.0f / sqrt(x * x + doubleSpacing * doubleSpacing + z * z);
+
+					float* normal = reinterpret_cast<Vector3*>(normalRow + column * normalStride)->getData();
+					normal[0] = x * inverseLength;
+					normal[1] = doubleSpacing * inverseLength;
+					normal[2] = z * inverseLength;
+				}
+			}
+		}
+
+		void TerrainCodec::deriveSectionNormals(const TerrainLayout& layout, unsigned int lodIndex,
+												const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+												const function<SectionReader>& readHeights, Vector3* normals,
+												unsigned int normalStride, TerrainScratch& scratch)
+		{
+			Vector2i resourceNorthWest = layout.toResourceSpace(lodIndex, sectionNorthWest);
+			Vector2ui lodSamples = layout.getLodSamples(lodIndex);
+
+			// The apron is only read where it falls within the map, elsewhere it is extrapolated from the edge.
+			unsigned int west = resourceNorthWest.X() > 0 ? 1 : 0;
+			unsigned int north = resourceNorthWest.Y() > 0 ? 1 : 0;
+			unsigned int east = resourceNorthWest.X() + sectionSamples.X() < lodSamples.X() ? 1 : 0;
+			unsigned int south = resourceNorthWest.Y() + sectionSamples.Y() < lodSamples.Y() ? 1 : 0;
+
+			Vector2ui readSamples(sectionSamples.X() + west + east, sectionSamples.Y() + north + south);
+			vector<float>& heights = scratch.apronHeights;
+			heights.resize(readSamples.X() * readSamples.Y());
+			readHeights(Vector2i(sectionNorthWest.X() - west, sectionNorthWest.Y() - north), readSamples,
+						heights.data());
+
+			unsigned int paddedWidth = sectionSamples.X() + 2;
+			unsigned int paddedHeight = sectionSamples.Y() + 2;
+			vector<float>& paddedHeights = scratch.paddedHeights;
+			paddedHeights.resize(paddedWidth * paddedHeight);
+			for (unsigned int row = 0; row < paddedHeight; row++)
+			{
+				unsigned int readRow = min(max(row + north, 1u) - 1, readSamples.Y() - 1);
+
+				for (unsigned int column = 0; column < paddedWidth; column++)
+				{
+					unsigned int readColumn = min(max(column + west, 1u) - 1, readSamples.X() - 1);
+
+					paddedHeights[row * paddedWidth + column] = heights[readRow * readSamples.X() + readColumn];
+				}
+			}
+
+			for (unsigned int row = 0; row < paddedHeight; row++)
+			{
+				float* paddedRow = &paddedHeights[row * paddedWidth];
+
+				if (west == 0)
+				{
+					paddedRow[0] = paddedRow[1] * 2.0f - paddedRow[2];
+				}
+				if (east == 0)
+				{
+					paddedRow[paddedWidth - 1] = paddedRow[paddedWidth - 2] * 2.0f - paddedRow[paddedWidth - 3];
+				}
+			}
+			for (unsigned int column = 0; column < paddedWidth; column++)
+			{
+				if (north == 0)
+				{
+					paddedHeights[column] = paddedHeights[paddedWidth + column] * 2.0f -
+							paddedHeights[paddedWidth * 2 + column];
+				}
+				if (south == 0)
+				{
+					paddedHeights[(paddedHeight - 1) * paddedWidth + column] =
+							paddedHeights[(paddedHeight - 2) * paddedWidth + column] * 2.0f -
+							paddedHeights[(paddedHeight - 3) * paddedWidth + column];
+				}
+			}
+
+			float spacing = static_cast<float>(layout.getLods()[lodIndex].sampleFrequency);
+			deriveNormals(paddedHeights.data(), sectionSamples, spacing, normals, normalStride);
+		}
+
+		void TerrainCodec::encodeHeights(const float* heights, unsigned int sampleCount, char* tile)
+		{
+			float minimum = *min_element(heights, heights + sampleCount);
+			float maximum = *max_element(heights, heights + sampleCount);
+			float scale = (maximum - minimum) / numeric_limits<uint16_t>::max();
+
+			memcpy(tile, &minimum, sizeof(float));
+			memcpy(tile + sizeof(float), &scale, sizeof(float));
+
+			uint16_t* encodedHeights = reinterpret_cast<uint16_t*>(tile + TerrainLayout::TILE_HEADER_SIZE);
+
+			for (unsigned int index = 0; index < sampleCount; index++)
+			{
+				encodedHeights[index] = 0;
+
+				if (scale > 0.0f)
+				{
+					encodedHeights[index] = static_cast<uint16_t>(lround((heights[index] - minimum) / scale));
+				}
+			}
+		}
+
+		void TerrainCodec::encodeNormals(const Vector3* normals, unsigned int sampleCount, uint8_t* encodedNormals)
+		{
+			encodeOctahedral(normals, sampleCount, encodedNormals);
+		}
+
+		void TerrainCodec::encodeNormals(const Vector3* normals, unsigned int sampleCount, uint16_t* encodedNormals)
+		{
+			encodeOctahedral(normals, sampleCount, encodedNormals);
+		}
+	}
+}
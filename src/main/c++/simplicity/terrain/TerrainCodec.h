@@ -0,0 +1,73 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef TERRAINCODEC_H
+#define TERRAINCODEC_H
+
+#include <cstdint>
+
+#include "TerrainLayout.h"
+#include "TerrainScratch.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		class TerrainCodec
+		{
+			public:
+				using SectionReader = void(const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+										   float* heights);
+
+				using TileReader = const char*(std::size_t offset, std::size_t size);
+
+				// Strides are in bytes, a destination stride equal to the sample size makes this a plain copy.
+				static void copySamples(const char* source, unsigned int sampleCount, unsigned int sampleSize,
+										char* destination, unsigned int destinationStride);
+
+				static void decodeHeights(const char* tile, unsigned int sampleCount, float* heights);
+
+				static void decodeNormals(const std::uint8_t* encodedNormals, unsigned int sampleCount,
+										  Vector3* normals);
+
+				static void decodeNormals(const std::uint16_t* encodedNormals, unsigned int sampleCount,
+										  Vector3* normals);
+
+				static void decodeSection(const TerrainLayout& layout, unsigned int lodIndex,
+										  const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+										  TerrainLayout::Component component,
+										  const std::function<TileReader>& readTile, char* destination,
+										  unsigned int destinationStride, TerrainScratch& scratch);
+
+				static void deriveNormals(const float* paddedHeights, const Vector2ui& samples, float spacing,
+										  Vector3* normals, unsigned int normalStride = sizeof(Vector3));
+
+				static void deriveSectionNormals(const TerrainLayout& layout, unsigned int lodIndex,
+												 const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+												 const std::function<SectionReader>& readHeights, Vector3* normals,
+												 unsigned int normalStride, TerrainScratch& scratch);
+
+				static void encodeHeights(const float* heights, unsigned int sampleCount, char* tile);
+
+				static void encodeNormals(const Vector3* normals, unsigned int sampleCount,
+										  std::uint8_t* encodedNormals);
+
+				static void encodeNormals(const Vector3* normals, unsigned int sampleCount,
+										  std::uint16_t* encodedNormals);
+
+			private:
+				static void decodeTile(const TerrainLayout& layout, TerrainLayout::Component component,
+									   const char* tile, unsigned int sampleCount, char* destination);
+		};
+	}
+}
+
+#endif //TERRAINCODEC_H
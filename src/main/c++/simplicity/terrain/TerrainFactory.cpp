@@ -1,4 +1,14 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "TerrainCodec.h"
 #include "TerrainFactory.h"
+#include "TerrainMetadata.h"
 
 using namespace std;
 
@@ -6,121 +16,696 @@ namespace simplicity
 {
 	namespace terrain
 	{
+		namespace
+		{
+			// The number of samples generated between writes to the resource.
+			const unsigned int BAND_SAMPLES = 1 << 20;
+
+			// A lower level of detail being built: the rows finished since they were last written, along with the two
+			// rows that can be in progress at once.
+			struct PyramidLevel
+			{
+				unsigned int columns;
+
+				vector<float> heights;
+
+				vector<Vector3> normals;
+
+				unsigned int ratio;
+
+				unsigned int reach;
+
+				vector<float> rowHeights;
+
+				vector<Vector3> rowNormals;
+			};
+
+			// Interpolates between the four samples around a point, splitting them into triangles the way TerrainChunk
+			// does.
+			float interpolate(const float* heights, unsigned int samples, unsigned int row, unsigned int column,
+							  float rowFraction, float columnFraction)
+			{
+				float northWest = heights[row * samples + column];
+				float northEast = heights[row * samples + column + 1];
+				float southWest = heights[(row + 1) * samples + column];
+				float southEast = heights[(row + 1) * samples + column + 1];
+
+				if (columnFraction < rowFraction)
+				{
+					return northWest + rowFraction * (southWest - northWest) + columnFraction * (southEast - southWest);
+				}
+
+				return northWest + columnFraction * (northEast - northWest) + rowFraction * (southEast - northEast);
+			}
+
+			// Adds a row of the highest frequency samples to the rows of the level whose filters cover it, and
+			// finishes the rows it is the last contribution to.
+			void reduceRow(PyramidLevel& level, const Vector2ui& mapSamples, unsigned int row, const float* heights,
+						   const Vector3* normals, TerrainFactory::Filter filter)
+			{
+				unsigned int firstLevelRow = (max(row, level.reach) - level.reach + level.ratio - 1) / level.ratio;
+				unsigned int lastLevelRow = (row + level.reach) / level.ratio;
+
+				for (unsigned int levelRow = firstLevelRow; levelRow <= lastLevelRow; levelRow++)
+				{
+					unsigned int center = levelRow * level.ratio;
+					if (center >= mapSamples.Y())
+					{
+						break;
+					}
+
+					unsigned int firstRow = max(center, level.reach) - level.reach;
+					unsigned int lastRow = min(center + level.reach, mapSamples.Y() - 1);
+					float* rowHeights = &level.rowHeights[(levelRow % 2) * level.columns];
+					Vector3* rowNormals = nullptr;
+					if (normals != nullptr)
+					{
+						rowNormals = &level.rowNormals[(levelRow % 2) * level.columns];
+					}
+
+					for (unsigned int column = 0; column < level.columns; column++)
+					{
+						unsigned int firstColumn = max(column * level.ratio, level.reach) - level.reach;
+						unsigned int lastColumn = min(column * level.ratio + level.reach, mapSamples.X() - 1);
+
+						float height = heights[firstColumn];
+						unsigned int highest = firstColumn;
+
+						for (unsigned int index = firstColumn + 1; index <= lastColumn; index++)
+						{
+							if (filter == TerrainFactory::Filter::BOX)
+							{
+								height += heights[index];
+							}
+							else if (heights[index] > height)
+							{
+								height = heights[index];
+								highest = index;
+							}
+						}
+
+						Vector3 normal;
+						if (normals != nullptr)
+						{
+							normal = normals[highest];
+
+							if (filter == TerrainFactory::Filter::BOX)
+							{
+								for (unsigned int index = firstColumn + 1; index <= lastColumn; index++)
+								{
+									normal += normals[index];
+								}
+							}
+						}
+
+						if (row == firstRow)
+						{
+							rowHeights[column] = height;
+						}
+						else if (filter == TerrainFactory::Filter::BOX)
+						{
+							rowHeights[column] += height;
+						}
+						else if (height > rowHeights[column])
+						{
+							rowHeights[column] = height;
+						}
+						else
+						{
+							// The row's maximum did not change, nor does its normal.
+							continue;
+						}
+
+						if (rowNormals != nullptr)
+						{
+							rowNormals[column] = row == firstRow || filter != TerrainFactory::Filter::BOX ?
+									normal : rowNormals[column] + normal;
+						}
+					}
+
+					if (row != lastRow)
+					{
+						continue;
+					}
+
+					for (unsigned int column = 0; column < level.columns; column++)
+					{
+						if (filter == TerrainFactory::Filter::BOX)
+						{
+							unsigned int firstColumn = max(column * level.ratio, level.reach) - level.reach;
+							unsigned int lastColumn = min(column * level.ratio + level.reach, mapSamples.X() - 1);
+							rowHeights[column] /= static_cast<float>((lastRow - firstRow + 1) *
+									(lastColumn - firstColumn + 1));
+
+							if (rowNormals != nullptr)
+							{
+								rowNormals[column].normalize();
+							}
+						}
+
+						level.heights.push_back(rowHeights[column]);
+
+						if (rowNormals != nullptr)
+						{
+							level.normals.push_back(rowNormals[column]);
+						}
+					}
+				}
+			}
+
+			// Splits [0, count) into one contiguous range per thread and waits for them all. The first exception thrown
+			// by the work is rethrown once every thread has finished.
+			void runInParallel(unsigned int count, unsigned int threadCount,
+							   const function<void(unsigned int, unsigned int)>& work)
+			{
+				unsigned int rangeSize = (count + threadCount - 1) / threadCount;
+				vector<exception_ptr> exceptions(threadCount);
+				vector<thread> threads;
+
+				auto runRange = [&work, &exceptions](unsigned int index, unsigned int first, unsigned int last)
+				{
+					try
+					{
+						work(first, last);
+					}
+					catch (...)
+					{
+						exceptions[index] = current_exception();
+					}
+				};
+
+				unsigned int index = 1;
+				for (unsigned int first = rangeSize; first < count; first += rangeSize)
+				{
+					threads.push_back(thread(runRange, index++, first, min(first + rangeSize, count)));
+				}
+
+				runRange(0, 0, min(rangeSize, count));
+
+				for (thread& thread : threads)
+				{
+					thread.join();
+				}
+
+				for (const exception_ptr& exception : exceptions)
+				{
+					if (exception != nullptr)
+					{
+						rethrow_exception(exception);
+					}
+				}
+			}
+
+			unsigned int resolveThreadCount(unsigned int threadCount)
+			{
+				if (threadCount == 0)
+				{
+					return max(thread::hardware_concurrency(), 1u);
+				}
+
+				return threadCount;
+			}
+		}
+
 		void TerrainFactory::createFlatTerrain(Resource& resource, const Vector2ui& mapSize,
-							   function<HeightFunction> heightFunction,
-							   const vector<unsigned int>& sampleFrequencies)
+							   function<HeightBlockFunction> heightBlockFunction,
+							   const vector<unsigned int>& sampleFrequencies, TerrainLayout::Normals normals,
+							   unsigned int threadCount, Filter filter)
 		{
 			Vector2ui mapSamples = mapSize;
 			mapSamples.X()++;
 			mapSamples.Y()++;
 
-			writeHighestFrequencySamples(resource, mapSamples, heightFunction, sampleFrequencies[0]);
+			writeHighestFrequencySamples(resource, mapSamples, heightBlockFunction, sampleFrequencies[0], normals,
+										 resolveThreadCount(threadCount));
 
 			if (sampleFrequencies.size() > 1)
 			{
-				writeLowerFrequencySamples(resource, mapSamples, sampleFrequencies);
+				writeLowerFrequencySamples(resource, mapSamples, sampleFrequencies, normals, filter);
+			}
+		}
+
+		void TerrainFactory::createFlatTerrain(Resource& resource, const Vector2ui& mapSize,
+							   function<HeightFunction> heightFunction,
+							   const vector<unsigned int>& sampleFrequencies, TerrainLayout::Normals normals,
+							   unsigned int threadCount, Filter filter)
+		{
+			createFlatTerrain(resource, mapSize, toBlockFunction(heightFunction), sampleFrequencies, normals,
+							  threadCount, filter);
+		}
+
+		void TerrainFactory::createMetadata(Resource& resource, const TerrainSource& source, const Vector2ui& mapSize,
+											unsigned int nodeSize, const vector<unsigned int>& sampleFrequencies)
+		{
+			unsigned int levelCount = sampleFrequencies.size();
+			for (unsigned int level = 1; level < levelCount; level++)
+			{
+				if (sampleFrequencies[level] != sampleFrequencies[0] << level)
+				{
+					throw invalid_argument("Each level of a quadtree must halve the samples of the level below.");
+				}
+			}
+
+			if (nodeSize % sampleFrequencies.back() != 0)
+			{
+				throw invalid_argument("Quadtree nodes must be a whole number of samples at every level of detail.");
+			}
+
+			unsigned int rootSize = nodeSize << (levelCount - 1);
+			if (mapSize.X() % rootSize != 0 || mapSize.Y() % rootSize != 0)
+			{
+				throw invalid_argument("The map must be a whole number of quadtree roots.");
+			}
+
+			TerrainMetadata::Node emptyNode;
+			emptyNode.error = 0.0f;
+			emptyNode.maximumHeight = numeric_limits<float>::lowest();
+			emptyNode.minimumHeight = numeric_limits<float>::max();
+
+			vector<Vector2ui> nodeCounts;
+			vector<vector<TerrainMetadata::Node>> levels;
+			for (unsigned int level = 0; level < levelCount; level++)
+			{
+				nodeCounts.push_back(Vector2ui(mapSize.X() / (nodeSize << level), mapSize.Y() / (nodeSize << level)));
+				levels.push_back(vector<TerrainMetadata::Node>(nodeCounts[level].X() * nodeCounts[level].Y(),
+															   emptyNode));
+			}
+
+			// Each node of level zero is compared with every level above it, so the highest frequency samples are
+			// only read once.
+			Vector2i mapNorthWest(-static_cast<int>(mapSize.X()) / 2, -static_cast<int>(mapSize.Y()) / 2);
+			unsigned int leafSize = nodeSize / sampleFrequencies[0];
+			unsigned int leafSamples = leafSize + 1;
+
+			for (unsigned int leafY = 0; leafY < nodeCounts[0].Y(); leafY++)
+			{
+				for (unsigned int leafX = 0; leafX < nodeCounts[0].X(); leafX++)
+				{
+					Vector2i northWest(mapNorthWest.X() + static_cast<int>(leafX * nodeSize),
+									   mapNorthWest.Y() + static_cast<int>(leafY * nodeSize));
+					vector<float> leafHeights =
+						source.getSectionHeights(northWest / static_cast<int>(sampleFrequencies[0]),
+												 Vector2ui(leafSize, leafSize), 0);
+
+					float minimumHeight = *min_element(leafHeights.begin(), leafHeights.end());
+					float maximumHeight = *max_element(leafHeights.begin(), leafHeights.end());
+
+					for (unsigned int level = 0; level < levelCount; level++)
+					{
+						unsigned int ratio = 1 << level;
+						unsigned int levelSize = leafSize / ratio;
+						unsigned int levelSamples = levelSize + 1;
+						float error = 0.0f;
+
+						if (level > 0)
+						{
+							vector<float> levelHeights =
+								source.getSectionHeights(northWest / static_cast<int>(sampleFrequencies[level]),
+														 Vector2ui(levelSize, levelSize), level);
+
+							for (unsigned int row = 0; row < leafSamples; row++)
+							{
+								// The last row and column interpolate from the cells before them.
+								unsigned int levelRow = min(row / ratio, levelSize - 1);
+								float rowFraction = static_cast<float>(row - levelRow * ratio) / ratio;
+
+								for (unsigned int column = 0; column < leafSamples; column++)
+								{
+									unsigned int levelColumn = min(column / ratio, levelSize - 1);
+									float columnFraction = static_cast<float>(column - levelColumn * ratio) / ratio;
+
+									float height = interpolate(levelHeights.data(), levelSamples, levelRow,
+															   levelColumn, rowFraction, columnFraction);
+									error = max(error, abs(height - leafHeights[row * leafSamples + column]));
+								}
+							}
+						}
+
+						TerrainMetadata::Node& node =
+							levels[level][(leafY >> level) * nodeCounts[level].X() + (leafX >> level)];
+						node.error = max(node.error, error);
+						node.maximumHeight = max(node.maximumHeight, maximumHeight);
+						node.minimumHeight = min(node.minimumHeight, minimumHeight);
+					}
+				}
+			}
+
+			resource.appendData(reinterpret_cast<char*>(&levelCount), sizeof(unsigned int));
+			resource.appendData(reinterpret_cast<const char*>(&mapSize), sizeof(Vector2ui));
+			resource.appendData(reinterpret_cast<char*>(&nodeSize), sizeof(unsigned int));
+
+			for (unsigned int level = 0; level < levelCount; level++)
+			{
+				unsigned int sampleFrequency = sampleFrequencies[level];
+				resource.appendData(reinterpret_cast<char*>(&sampleFrequency), sizeof(unsigned int));
+				resource.appendData(reinterpret_cast<char*>(&nodeCounts[level]), sizeof(Vector2ui));
+				resource.appendData(reinterpret_cast<char*>(levels[level].data()),
+									levels[level].size() * sizeof(TerrainMetadata::Node));
 			}
 		}
 
-		float TerrainFactory::readHeight(istream& stream, const Vector2ui& mapSamples, unsigned int x,
-										 unsigned int y)
+		void TerrainFactory::createTiledTerrain(Resource& resource, const Vector2ui& mapSize, unsigned int tileSize,
+												function<HeightBlockFunction> heightBlockFunction,
+												const vector<unsigned int>& sampleFrequencies,
+												TerrainLayout::Encoding encoding, TerrainLayout::Normals normals,
+												unsigned int threadCount)
 		{
-			float height;
+			vector<LevelOfDetail> lods;
+			for (unsigned int sampleFrequency : sampleFrequencies)
+			{
+				LevelOfDetail lod;
+				lod.layerCount = 1;
+				lod.sampleFrequency = sampleFrequency;
+				lods.push_back(lod);
+			}
+
+			TerrainLayout layout(mapSize, lods, TerrainLayout::Type::TILED, tileSize, encoding, normals);
+			threadCount = resolveThreadCount(threadCount);
+
+			for (unsigned int lodIndex = 0; lodIndex < lods.size(); lodIndex++)
+			{
+				Vector2ui tileCount = layout.getTileCount(lodIndex);
+				size_t tileBytes = layout.getTileBytes(lodIndex);
+
+				// A row of tiles is generated in parallel and then written in one go.
+				vector<char> tileRow(tileCount.X() * tileBytes);
 
-			stream.seekg((y * mapSamples.X() + x) * sizeof(float));
-			stream.read(reinterpret_cast<char*>(&height), sizeof(float));
+				for (unsigned int tileY = 0; tileY < tileCount.Y(); tileY++)
+				{
+					runInParallel(tileCount.X(), threadCount, [&](unsigned int firstTileX, unsigned int lastTileX)
+					{
+						for (unsigned int tileX = firstTileX; tileX < lastTileX; tileX++)
+						{
+							writeTile(layout, lodIndex, Vector2ui(tileX, tileY), heightBlockFunction,
+									  sampleFrequencies[0], &tileRow[tileX * tileBytes]);
+						}
+					});
+
+					resource.appendData(tileRow.data(), tileRow.size());
+				}
+			}
+		}
 
-			return height;
+		void TerrainFactory::createTiledTerrain(Resource& resource, const Vector2ui& mapSize, unsigned int tileSize,
+												function<HeightFunction> heightFunction,
+												const vector<unsigned int>& sampleFrequencies,
+												TerrainLayout::Encoding encoding, TerrainLayout::Normals normals,
+												unsigned int threadCount)
+		{
+			createTiledTerrain(resource, mapSize, tileSize, toBlockFunction(heightFunction), sampleFrequencies, encoding,
+							   normals, threadCount);
 		}
 
-		Vector3 TerrainFactory::readNormal(istream& stream, const Vector2ui& mapSamples, unsigned int x,
-										 unsigned int y)
+		Vector3 TerrainFactory::getNormal(float height, float heightN, float heightE, float heightS, float heightW)
 		{
-			Vector3 normal;
+			Vector3 point(0.0f, height, 0.0f);
+
+			Vector3 edgeN = Vector3(0.0f, heightN, -1.0f) - point;
+			edgeN.normalize();
+			Vector3 edgeE = Vector3(1.0f, heightE, 0.0f) - point;
+			edgeE.normalize();
+			Vector3 edgeS = Vector3(0.0f, heightS, 1.0f) - point;
+			edgeS.normalize();
+			Vector3 edgeW = Vector3(-1.0f, heightW, 0.0f) - point;
+			edgeW.normalize();
 
-			unsigned int basePosition = mapSamples.X() * mapSamples.Y() * sizeof(float);
-			stream.seekg(basePosition + (y * mapSamples.X() + x) * sizeof(float) * 3);
-			stream.read(reinterpret_cast<char*>(normal.getData()), sizeof(float) * 3);
+			Vector3 normal = crossProduct(edgeN, edgeW) + crossProduct(edgeW, edgeS) +
+							 crossProduct(edgeS, edgeE) + crossProduct(edgeE, edgeN);
+			normal.normalize();
 
 			return normal;
 		}
 
+		function<TerrainFactory::HeightBlockFunction> TerrainFactory::toBlockFunction(
+				function<HeightFunction> heightFunction)
+		{
+			return [heightFunction](const Vector2i& first, const Vector2ui& samples, int spacing, float* heights)
+			{
+				for (unsigned int xIndex = 0; xIndex < samples.X(); xIndex++)
+				{
+					int x = first.X() + static_cast<int>(xIndex) * spacing;
+
+					for (unsigned int yIndex = 0; yIndex < samples.Y(); yIndex++)
+					{
+						heights[xIndex * samples.Y() + yIndex] =
+								heightFunction(x, first.Y() + static_cast<int>(yIndex) * spacing);
+					}
+				}
+			};
+		}
+
 		void TerrainFactory::writeHighestFrequencySamples(Resource& resource, const Vector2ui& mapSamples,
-														  function<HeightFunction> heightFunction,
-														  unsigned int sampleFrequency)
+														  const function<HeightBlockFunction>& heightBlockFunction,
+														  unsigned int sampleFrequency, TerrainLayout::Normals normals,
+														  unsigned int threadCount)
 		{
+			// The outer loop runs along x, so a band of rows is a contiguous part of the resource.
+			unsigned int rows = (mapSamples.X() + sampleFrequency - 1) / sampleFrequency;
+			unsigned int columns = (mapSamples.Y() + sampleFrequency - 1) / sampleFrequency;
+			unsigned int bandRows = max(BAND_SAMPLES / columns, 1u);
+			int frequency = sampleFrequency;
+
 			// Heights
-			for (int x = 0; x < mapSamples.X(); x += sampleFrequency)
+			vector<float> heights(bandRows * columns);
+			for (unsigned int band = 0; band < rows; band += bandRows)
 			{
-				for (int y = 0; y < mapSamples.Y(); y += sampleFrequency)
+				unsigned int bandSize = min(bandRows, rows - band);
+
+				runInParallel(bandSize, threadCount, [&](unsigned int firstRow, unsigned int lastRow)
 				{
-					float height = heightFunction(x, y);
+					heightBlockFunction(Vector2i((band + firstRow) * frequency, 0), Vector2ui(lastRow - firstRow, columns),
+										frequency, &heights[firstRow * columns]);
+				});
 
-					resource.appendData(reinterpret_cast<char*>(&height), sizeof(float));
-				}
+				resource.appendData(reinterpret_cast<char*>(heights.data()), bandSize * columns * sizeof(float));
 			}
 
-			// Normals
-			for (int x = 0; x < mapSamples.X(); x += sampleFrequency)
+			if (normals == TerrainLayout::Normals::DERIVED)
 			{
-				for (int y = 0; y < mapSamples.Y(); y += sampleFrequency)
-				{
-					float height = heightFunction(x, y);
-					float heightN = heightFunction(x, y - sampleFrequency);
-					float heightE = heightFunction(x + sampleFrequency, y);
-					float heightS = heightFunction(x, y + sampleFrequency);
-					float heightW = heightFunction(x - sampleFrequency, y);
+				return;
+			}
 
-					Vector3 point(0.0f, height, 0.0f);
+			// Normals, from the heights written above. Only the ring around the map is evaluated again.
+			unique_ptr<istream> stream = resource.getInputStream();
+			unsigned int paddedWidth = columns + 2;
+			vector<float> paddedHeights((bandRows + 2) * paddedWidth);
+			vector<Vector3> normalBand(bandRows * columns);
 
-					Vector3 edgeN = Vector3(0.0f, heightN, -1.0f) - point;
-					edgeN.normalize();
-					Vector3 edgeE = Vector3(1.0f, heightE, 0.0f) - point;
-					edgeE.normalize();
-					Vector3 edgeS = Vector3(0.0f, heightS, 1.0f) - point;
-					edgeS.normalize();
-					Vector3 edgeW = Vector3(-1.0f, heightW, 0.0f) - point;
-					edgeW.normalize();
+			for (unsigned int band = 0; band < rows; band += bandRows)
+			{
+				unsigned int bandSize = min(bandRows, rows - band);
+				unsigned int firstRead = max(band, 1u) - 1;
+				unsigned int lastRead = min(band + bandSize, rows - 1);
 
-					Vector3 normal = crossProduct(edgeN, edgeW) + crossProduct(edgeW, edgeS) +
-									 crossProduct(edgeS, edgeE) + crossProduct(edgeE, edgeN);
-					normal.normalize();
+				stream->seekg(static_cast<size_t>(firstRead) * columns * sizeof(float));
+				for (unsigned int row = firstRead; row <= lastRead; row++)
+				{
+					stream->read(reinterpret_cast<char*>(&paddedHeights[(row + 1 - band) * paddedWidth + 1]),
+								 columns * sizeof(float));
+				}
 
-					resource.appendData(reinterpret_cast<char*>(normal.getData()), sizeof(float) * 3);
+				if (band == 0)
+				{
+					heightBlockFunction(Vector2i(-frequency, 0), Vector2ui(1, columns), frequency, &paddedHeights[1]);
+				}
+				if (band + bandSize == rows)
+				{
+					heightBlockFunction(Vector2i(rows * frequency, 0), Vector2ui(1, columns), frequency,
+										&paddedHeights[(bandSize + 1) * paddedWidth + 1]);
 				}
+
+				runInParallel(bandSize, threadCount, [&](unsigned int firstRow, unsigned int lastRow)
+				{
+					Vector2i first((band + firstRow) * frequency, 0);
+					Vector2ui samples(lastRow - firstRow, 1);
+					vector<float> west(samples.X());
+					vector<float> east(samples.X());
+					heightBlockFunction(Vector2i(first.X(), -frequency), samples, frequency, west.data());
+					heightBlockFunction(Vector2i(first.X(), columns * frequency), samples, frequency, east.data());
+
+					for (unsigned int row = firstRow; row < lastRow; row++)
+					{
+						float* paddedRow = &paddedHeights[(row + 1) * paddedWidth];
+						paddedRow[0] = west[row - firstRow];
+						paddedRow[columns + 1] = east[row - firstRow];
+
+						for (unsigned int column = 0; column < columns; column++)
+						{
+							const float* center = &paddedRow[column + 1];
+
+							normalBand[row * columns + column] = getNormal(*center, *(center - 1),
+									*(center + paddedWidth), *(center + 1), *(center - paddedWidth));
+						}
+					}
+				});
+
+				resource.appendData(reinterpret_cast<char*>(normalBand.data()), bandSize * columns * sizeof(Vector3));
 			}
 		}
 
 		void TerrainFactory::writeLowerFrequencySamples(Resource& resource, const Vector2ui& mapSamples,
-														const vector<unsigned int>& sampleFrequencies)
+														const vector<unsigned int>& sampleFrequencies,
+														TerrainLayout::Normals normals, Filter filter)
 		{
 			unsigned int highestSampleFrequency = sampleFrequencies[0];
+			unsigned int width = mapSamples.X();
+			unsigned int height = mapSamples.Y();
+			bool storeNormals = normals == TerrainLayout::Normals::STORED;
+
 			unique_ptr<istream> stream = resource.getInputStream();
+			size_t normalsOffset = static_cast<size_t>(width) * height * sizeof(float);
+			unsigned int bandRows = max(BAND_SAMPLES / width, 1u);
+			vector<float> heightBand(bandRows * width);
+			vector<Vector3> normalBand(storeNormals ? bandRows * width : 0);
 
-			for (unsigned int sample = 1; sample < sampleFrequencies.size(); sample++)
+			vector<PyramidLevel> levels(sampleFrequencies.size() - 1);
+			for (unsigned int levelIndex = 0; levelIndex < levels.size(); levelIndex++)
 			{
-				unsigned int sampleFrequencyRatio = sampleFrequencies[sample] / highestSampleFrequency;
+				PyramidLevel& level = levels[levelIndex];
+				level.ratio = sampleFrequencies[levelIndex + 1] / highestSampleFrequency;
+				level.reach = filter == Filter::POINT ? 0 : level.ratio / 2;
+				level.columns = (width + level.ratio - 1) / level.ratio;
+				level.rowHeights.resize(level.columns * 2);
+				level.rowNormals.resize(storeNormals ? level.columns * 2 : 0);
+			}
+
+			// One pass over the highest frequency samples reduces every level. Each level's heights and then normals
+			// follow the previous level's in the resource, so the levels are held until the pass is done.
+			for (unsigned int band = 0; band < height; band += bandRows)
+			{
+				unsigned int bandSize = min(bandRows, height - band);
+
+				stream->seekg(static_cast<size_t>(band) * width * sizeof(float));
+				stream->read(reinterpret_cast<char*>(heightBand.data()), bandSize * width * sizeof(float));
+
+				if (storeNormals)
+				{
+					stream->seekg(normalsOffset + static_cast<size_t>(band) * width * sizeof(Vector3));
+					stream->read(reinterpret_cast<char*>(normalBand.data()), bandSize * width * sizeof(Vector3));
+				}
 
-				// Heights
-				for (unsigned int row = 0; row < mapSamples.Y(); row += sampleFrequencyRatio)
+				for (PyramidLevel& level : levels)
 				{
-					for (unsigned int column = 0; column < mapSamples.X(); column += sampleFrequencyRatio)
+					for (unsigned int row = band; row < band + bandSize; row++)
 					{
-						float height = readHeight(*stream, mapSamples, column,row);
-						resource.appendData(reinterpret_cast<char*>(&height), sizeof(float));
+						reduceRow(level, mapSamples, row, &heightBand[(row - band) * width],
+								  storeNormals ? &normalBand[(row - band) * width] : nullptr, filter);
 					}
 				}
+			}
+
+			for (const PyramidLevel& level : levels)
+			{
+				resource.appendData(reinterpret_cast<const char*>(level.heights.data()),
+									level.heights.size() * sizeof(float));
 
-				// Normals
-				for (unsigned int row = 0; row < mapSamples.Y(); row += sampleFrequencyRatio)
+				if (storeNormals)
 				{
-					for (unsigned int column = 0; column < mapSamples.X(); column += sampleFrequencyRatio)
+					resource.appendData(reinterpret_cast<const char*>(level.normals.data()),
+										level.normals.size() * sizeof(Vector3));
+				}
+			}
+		}
+
+		void TerrainFactory::writeTile(const TerrainLayout& layout, unsigned int lodIndex, const Vector2ui& tile,
+									   const function<HeightBlockFunction>& heightBlockFunction,
+									   unsigned int highestSampleFrequency, char* destination)
+		{
+			int sampleFrequency = layout.getLods()[lodIndex].sampleFrequency;
+			int highestFrequency = highestSampleFrequency;
+			Vector2ui lodSamples = layout.getLodSamples(lodIndex);
+			unsigned int tileSamples = layout.getTileSamples(lodIndex);
+			unsigned int tileStep = tileSamples - 1;
+			unsigned int sampleCount = tileSamples * tileSamples;
+			bool storeNormals = layout.getNormals() == TerrainLayout::Normals::STORED;
+
+			// Tiles at the edge of the map repeat its last row and column, so only the part within the map is
+			// evaluated. At the highest frequency the neighbours needed for the normals are samples too, so a ring
+			// around that part is evaluated with it.
+			int firstX = tile.X() * tileStep;
+			int firstY = tile.Y() * tileStep;
+			int lastX = min(tile.X() * tileStep + tileStep, lodSamples.X() - 1);
+			int lastY = min(tile.Y() * tileStep + tileStep, lodSamples.Y() - 1);
+			bool ring = storeNormals && sampleFrequency == highestFrequency;
+			int ringSize = ring ? 1 : 0;
+
+			// Matches the linear layout, where the rows of the highest frequency samples run along x.
+			Vector2ui gridSamples(lastY - firstY + 1 + ringSize * 2, lastX - firstX + 1 + ringSize * 2);
+			Vector2i gridFirst((firstY - ringSize) * sampleFrequency, (firstX - ringSize) * sampleFrequency);
+			unsigned int gridWidth = gridSamples.Y();
+
+			vector<float> gridHeights(gridSamples.X() * gridSamples.Y());
+			heightBlockFunction(gridFirst, gridSamples, sampleFrequency, gridHeights.data());
+
+			// Elsewhere the neighbours fall between the samples.
+			vector<float> neighbours[4];
+			if (storeNormals && !ring)
+			{
+				Vector2i offsets[] = { Vector2i(0, -highestFrequency), Vector2i(highestFrequency, 0),
+									   Vector2i(0, highestFrequency), Vector2i(-highestFrequency, 0) };
+
+				for (unsigned int direction = 0; direction < 4; direction++)
+				{
+					neighbours[direction].resize(gridHeights.size());
+					heightBlockFunction(gridFirst + offsets[direction], gridSamples, sampleFrequency,
+										neighbours[direction].data());
+				}
+			}
+
+			vector<float> heights(sampleCount);
+			vector<Vector3> tileNormals(storeNormals ? sampleCount : 0);
+			for (unsigned int row = 0; row < tileSamples; row++)
+			{
+				for (unsigned int column = 0; column < tileSamples; column++)
+				{
+					int resourceX = min(firstX + static_cast<int>(column), lastX);
+					int resourceY = min(firstY + static_cast<int>(row), lastY);
+					unsigned int index = (resourceY - firstY + ringSize) * gridWidth + resourceX - firstX + ringSize;
+					const float* center = &gridHeights[index];
+
+					heights[row * tileSamples + column] = *center;
+
+					if (ring)
+					{
+						tileNormals[row * tileSamples + column] = getNormal(*center, *(center - 1),
+								*(center + gridWidth), *(center + 1), *(center - gridWidth));
+					}
+					else if (storeNormals)
 					{
-						Vector3 normal = readNormal(*stream, mapSamples, column, row);
-						resource.appendData(reinterpret_cast<char*>(normal.getData()), sizeof(float) * 3);
+						tileNormals[row * tileSamples + column] = getNormal(*center, neighbours[0][index],
+								neighbours[1][index], neighbours[2][index], neighbours[3][index]);
 					}
 				}
 			}
+
+			TerrainLayout::Encoding encoding = layout.getEncoding();
+			char* normalsDestination =
+					destination + layout.getTileComponentOffset(lodIndex, TerrainLayout::Component::NORMALS);
+
+			if (encoding == TerrainLayout::Encoding::FLOAT)
+			{
+				memcpy(destination, heights.data(), sampleCount * TerrainLayout::HEIGHT_STRIDE);
+
+				if (storeNormals)
+				{
+					memcpy(normalsDestination, tileNormals.data(), sampleCount * TerrainLayout::NORMAL_STRIDE);
+				}
+
+				return;
+			}
+
+			TerrainCodec::encodeHeights(heights.data(), sampleCount, destination);
+
+			if (storeNormals && encoding == TerrainLayout::Encoding::QUANTIZED_8)
+			{
+				TerrainCodec::encodeNormals(tileNormals.data(), sampleCount,
+											reinterpret_cast<uint8_t*>(normalsDestination));
+			}
+			else if (storeNormals)
+			{
+				TerrainCodec::encodeNormals(tileNormals.data(), sampleCount,
+											reinterpret_cast<uint16_t*>(normalsDestination));
+			}
 		}
 	}
 }
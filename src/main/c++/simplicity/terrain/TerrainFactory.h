@@ -4,6 +4,9 @@
 #include <simplicity/math/Vector.h>
 #include <simplicity/resources/Resource.h>
 
+#include "TerrainLayout.h"
+#include "TerrainSource.h"
+
 namespace simplicity
 {
 	namespace terrain
@@ -11,25 +14,75 @@ namespace simplicity
 		class TerrainFactory
 		{
 			public:
+				// How the lower frequency samples are taken from the highest frequency samples around them. MAX keeps
+				// peaks from disappearing in the distance.
+				enum class Filter
+				{
+					BOX,
+					MAX,
+					POINT
+				};
+
+				// Writes samples.X() * samples.Y() heights spaced apart from first, x-major (the heights for each x are
+				// contiguous) like the highest frequency samples in a resource.
+				using HeightBlockFunction = void(const Vector2i& first, const Vector2ui& samples, int spacing,
+												 float* heights);
+
 				using HeightFunction = float(int x, int y);
 
+				// The height function is only called from one thread at a time unless threadCount is more than one
+				// (zero uses one per core), in which case it must be safe to call concurrently. Exceptions it throws
+				// are passed on once every thread has stopped.
+				static void createFlatTerrain(Resource& resource, const Vector2ui& mapSize,
+											  std::function<HeightBlockFunction> heightBlockFunction,
+											  const std::vector<unsigned int>& sampleFrequencies = { 1 },
+											  TerrainLayout::Normals normals = TerrainLayout::Normals::STORED,
+											  unsigned int threadCount = 1, Filter filter = Filter::POINT);
+
 				static void createFlatTerrain(Resource& resource, const Vector2ui& mapSize,
 											  std::function<HeightFunction> heightFunction,
-											  const std::vector<unsigned int>& sampleFrequencies = { 1 });
+											  const std::vector<unsigned int>& sampleFrequencies = { 1 },
+											  TerrainLayout::Normals normals = TerrainLayout::Normals::STORED,
+											  unsigned int threadCount = 1, Filter filter = Filter::POINT);
 
-			private:
-				static float readHeight(std::istream& stream, const Vector2ui& mapSamples, unsigned int x,
-										unsigned int y);
+				// Writes the quadtree read by TerrainMetadata for a terrain the source reads. Level n of the tree uses
+				// the source's level of detail n, whose sample frequency must be double that of the level below. The
+				// nodes of level zero are nodeSize across.
+				static void createMetadata(Resource& resource, const TerrainSource& source, const Vector2ui& mapSize,
+										   unsigned int nodeSize,
+										   const std::vector<unsigned int>& sampleFrequencies = { 1 });
 
-				static Vector3 readNormal(std::istream& stream, const Vector2ui& mapSamples, unsigned int x,
-										unsigned int y);
+				static void createTiledTerrain(Resource& resource, const Vector2ui& mapSize, unsigned int tileSize,
+											   std::function<HeightBlockFunction> heightBlockFunction,
+											   const std::vector<unsigned int>& sampleFrequencies = { 1 },
+											   TerrainLayout::Encoding encoding = TerrainLayout::Encoding::FLOAT,
+											   TerrainLayout::Normals normals = TerrainLayout::Normals::STORED,
+											   unsigned int threadCount = 1);
+
+				static void createTiledTerrain(Resource& resource, const Vector2ui& mapSize, unsigned int tileSize,
+											   std::function<HeightFunction> heightFunction,
+											   const std::vector<unsigned int>& sampleFrequencies = { 1 },
+											   TerrainLayout::Encoding encoding = TerrainLayout::Encoding::FLOAT,
+											   TerrainLayout::Normals normals = TerrainLayout::Normals::STORED,
+											   unsigned int threadCount = 1);
+
+				static std::function<HeightBlockFunction> toBlockFunction(std::function<HeightFunction> heightFunction);
+
+			private:
+				static Vector3 getNormal(float height, float heightN, float heightE, float heightS, float heightW);
 
 				static void writeHighestFrequencySamples(Resource& resource, const Vector2ui& mapSamples,
-														 std::function<HeightFunction> heightFunction,
-														 unsigned int sampleFrequency);
+														 const std::function<HeightBlockFunction>& heightBlockFunction,
+														 unsigned int sampleFrequency, TerrainLayout::Normals normals,
+														 unsigned int threadCount);
 
 				static void writeLowerFrequencySamples(Resource& resource, const Vector2ui& mapSamples,
-													   const std::vector<unsigned int>& sampleFrequencies);
+													   const std::vector<unsigned int>& sampleFrequencies,
+													   TerrainLayout::Normals normals, Filter filter);
+
+				static void writeTile(const TerrainLayout& layout, unsigned int lodIndex, const Vector2ui& tile,
+									  const std::function<HeightBlockFunction>& heightBlockFunction,
+									  unsigned int highestSampleFrequency, char* destination);
 		};
 	}
 }
@@ -0,0 +1,309 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "TerrainHeightField.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		TerrainHeightField::TerrainHeightField(const TerrainSource& source, const Vector2i& northWest,
+											   const Vector2ui& size, unsigned int lodIndex,
+											   unsigned int sampleFrequency) :
+			cells(size.X() / sampleFrequency, size.Y() / sampleFrequency),
+			heightMap(),
+			levels(),
+			northWest(northWest),
+			scale(static_cast<float>(sampleFrequency))
+		{
+			if (sampleFrequency == 0 || cells.X() == 0 || cells.Y() == 0 || size.X() % sampleFrequency != 0 ||
+				size.Y() % sampleFrequency != 0 || northWest.X() % static_cast<int>(sampleFrequency) != 0 ||
+				northWest.Y() % static_cast<int>(sampleFrequency) != 0)
+			{
+				throw invalid_argument("The height field must cover whole samples of its level of detail");
+			}
+
+			Vector2i sectionNorthWest(northWest.X() / static_cast<int>(sampleFrequency),
+									  northWest.Y() / static_cast<int>(sampleFrequency));
+			heightMap = source.getSectionHeights(sectionNorthWest, cells, lodIndex);
+
+			// The first level holds the highest corner of each cell, each level above the highest of up to four
+			// below it, until one covers the whole field.
+			Level cellLevel;
+			cellLevel.cells = cells;
+			cellLevel.maximumHeights.resize(cells.X() * cells.Y());
+
+			unsigned int samples = cells.X() + 1;
+			for (unsigned int y = 0; y < cells.Y(); y++)
+			{
+				for (unsigned int x = 0; x < cells.X(); x++)
+				{
+					unsigned int index = y * samples + x;
+					cellLevel.maximumHeights[y * cells.X() + x] =
+						max(max(heightMap[index], heightMap[index + 1]),
+							max(heightMap[index + samples], heightMap[index + samples + 1]));
+				}
+			}
+
+			levels.push_back(move(cellLevel));
+
+			while (levels.back().cells.X() > 1 || levels.back().cells.Y() > 1)
+			{
+				const Level& below = levels.back();
+
+				Level level;
+				level.cells = Vector2ui((below.cells.X() + 1) / 2, (below.cells.Y() + 1) / 2);
+				level.maximumHeights.resize(level.cells.X() * level.cells.Y(), -numeric_limits<float>::max());
+
+				for (unsigned int y = 0; y < below.cells.Y(); y++)
+				{
+					for (unsigned int x = 0; x < below.cells.X(); x++)
+					{
+						float& maximumHeight = level.maximumHeights[(y / 2) * level.cells.X() + x / 2];
+						maximumHeight = max(maximumHeight, below.maximumHeights[y * below.cells.X() + x]);
+					}
+				}
+
+				levels.push_back(move(level));
+			}
+		}
+
+		bool TerrainHeightField::intersect(const Ray& ray, unsigned int level, const Vector2ui& node, float first,
+										   float last, float& distance) const
+		{
+			if (!intersectNode(ray, level, node, first, last))
+			{
+				return false;
+			}
+
+			// The ray cannot meet anything below it if it stays above the highest point of the node.
+			float lowest = min(ray.origin.Y() + ray.direction.Y() * first, ray.origin.Y() + ray.direction.Y() * last);
+			if (lowest > levels[level].maximumHeights[node.Y() * levels[level].cells.X() + node.X()])
+			{
+				return false;
+			}
+
+			if (level == 0)
+			{
+				return intersectCell(ray, node, first, last, distance);
+			}
+
+			// The children are visited nearest first so the first one hit holds the nearest point.
+			const Level& below = levels[level - 1];
+			unsigned int nearX = ray.direction.X() < 0.0f ? 1 : 0;
+			unsigned int nearY = ray.direction.Z() < 0.0f ? 1 : 0;
+
+			Vector2ui children[4];
+			float entries[4];
+			unsigned int childCount = 0;
+			for (unsigned int offsetY = 0; offsetY < 2; offsetY++)
+			{
+				for (unsigned int offsetX = 0; offsetX < 2; offsetX++)
+				{
+					Vector2ui child(node.X() * 2 + (offsetX ^ nearX), node.Y() * 2 + (offsetY ^ nearY));
+					float childFirst = first;
+					float childLast = last;
+					if (child.X() < below.cells.X() && child.Y() < below.cells.Y() &&
+						intersectNode(ray, level - 1, child, childFirst, childLast))
+					{
+						children[childCount] = child;
+						entries[childCount] = childFirst;
+						childCount++;
+					}
+				}
+			}
+
+			for (unsigned int index = 1; index < childCount; index++)
+			{
+				for (unsigned int other = index; other > 0 && entries[other] < entries[other - 1]; other--)
+				{
+					swap(entries[other], entries[other - 1]);
+					swap(children[other], children[other - 1]);
+				}
+			}
+
+			for (unsigned int index = 0; index < childCount; index++)
+			{
+				if (intersect(ray, level - 1, children[index], first, last, distance))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		bool TerrainHeightField::intersectCell(const Ray& ray, const Vector2ui& cell, float first, float last,
+											   float& distance) const
+		{
+			unsigned int samples = cells.X() + 1;
+			unsigned int index = cell.Y() * samples + cell.X();
+			float northWestHeight = heightMap[index];
+			float northEastHeight = heightMap[index + 1];
+			float southWestHeight = heightMap[index + samples];
+			float southEastHeight = heightMap[index + samples + 1];
+
+			// Relative to the cell, u runs east and v south. The cell is split from north west to south east.
+			float u = ray.origin.X() - cell.X();
+			float v = ray.origin.Z() - cell.Y();
+
+			auto getHeight = [=](float atU, float atV)
+			{
+				if (atU < atV)
+				{
+					return northWestHeight + atV * (southWestHeight - northWestHeight) +
+						   atU * (southEastHeight - southWestHeight);
+				}
+
+				return northWestHeight + atU * (northEastHeight - northWestHeight) +
+					   atV * (southEastHeight - northEastHeight);
+			};
+
+			float firstU = u + ray.direction.X() * first;
+			float firstV = v + ray.direction.Z() * first;
+			if (ray.origin.Y() + ray.direction.Y() * first <= getHeight(firstU, firstV))
+			{
+				distance = first;
+				return true;
+			}
+
+			// Each triangle is a plane of the form height = a + b * u + c * v.
+			float planes[2][3] =
+			{
+				{ northWestHeight, southEastHeight - southWestHeight, southWestHeight - northWestHeight },
+				{ northWestHeight, northEastHeight - northWestHeight, southEastHeight - northEastHeight }
+			};
+
+			bool hit = false;
+			for (unsigned int triangle = 0; triangle < 2; triangle++)
+			{
+				const float* plane = planes[triangle];
+				float rate = ray.direction.Y() - plane[1] * ray.direction.X() - plane[2] * ray.direction.Z();
+				if (rate == 0.0f)
+				{
+					continue;
+				}
+
+				float crossing = (plane[0] + plane[1] * u + plane[2] * v - ray.origin.Y()) / rate;
+				if (crossing < first || crossing > last || (hit && crossing >= distance))
+				{
+					continue;
+				}
+
+				float crossingU = u + ray.direction.X() * crossing;
+				float crossingV = v + ray.direction.Z() * crossing;
+				if ((triangle == 0 && crossingU <= crossingV) || (triangle == 1 && crossingU >= crossingV))
+				{
+					distance = crossing;
+					hit = true;
+				}
+			}
+
+			return hit;
+		}
+
+		bool TerrainHeightField::intersectNode(const Ray& ray, unsigned int level, const Vector2ui& node, float& first,
+											   float& last) const
+		{
+			float minimums[2] =
+			{
+				static_cast<float>(node.X() << level),
+				static_cast<float>(node.Y() << level)
+			};
+			float maximums[2] =
+			{
+				static_cast<float>(min((node.X() + 1) << level, cells.X())),
+				static_cast<float>(min((node.Y() + 1) << level, cells.Y()))
+			};
+			float origins[2] = { ray.origin.X(), ray.origin.Z() };
+			float directions[2] = { ray.direction.X(), ray.direction.Z() };
+
+			for (unsigned int axis = 0; axis < 2; axis++)
+			{
+				if (directions[axis] == 0.0f)
+				{
+					if (origins[axis] < minimums[axis] || origins[axis] > maximums[axis])
+					{
+						return false;
+					}
+
+					continue;
+				}
+
+				float entry = (minimums[axis] - origins[axis]) / directions[axis];
+				float exit = (maximums[axis] - origins[axis]) / directions[axis];
+				if (entry > exit)
+				{
+					swap(entry, exit);
+				}
+
+				first = max(first, entry);
+				last = min(last, exit);
+			}
+
+			return first <= last;
+		}
+
+		bool TerrainHeightField::lineOfSight(const Vector3& from, const Vector3& to) const
+		{
+			Vector3 direction = to - from;
+			float distance = direction.getMagnitude();
+			if (distance == 0.0f)
+			{
+				Vector3 hit;
+				return !raycast(from, Vector3(0.0f, -1.0f, 0.0f), 0.0f, hit);
+			}
+
+			float hitDistance;
+			return !intersect(toRay(from, direction / distance), levels.size() - 1, Vector2ui(0, 0), 0.0f, distance,
+							  hitDistance);
+		}
+
+		bool TerrainHeightField::raycast(const Vector3& origin, const Vector3& direction, float maxDistance,
+										 Vector3& hit) const
+		{
+			float magnitude = direction.getMagnitude();
+			if (magnitude == 0.0f)
+			{
+				return false;
+			}
+
+			Vector3 unitDirection = direction / magnitude;
+
+			float distance;
+			if (!intersect(toRay(origin, unitDirection), levels.size() - 1, Vector2ui(0, 0), 0.0f, maxDistance,
+						   distance))
+			{
+				return false;
+			}
+
+			hit = origin + unitDirection * distance;
+
+			return true;
+		}
+
+		TerrainHeightField::Ray TerrainHeightField::toRay(const Vector3& origin, const Vector3& direction) const
+		{
+			Ray ray;
+			ray.direction = Vector3(direction.X() / scale, direction.Y(), direction.Z() / scale);
+			ray.origin = Vector3((origin.X() - northWest.X()) / scale, origin.Y(),
+								 (origin.Z() - northWest.Y()) / scale);
+
+			return ray;
+		}
+	}
+}
@@ -0,0 +1,80 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef TERRAINHEIGHTFIELD_H
+#define TERRAINHEIGHTFIELD_H
+
+#include <vector>
+
+#include "TerrainSource.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// An area of terrain held in memory for ray queries, triangulated the way TerrainChunk does it. Rays skip
+		// the space above the terrain using a hierarchy of the highest height of ever larger areas. It is not
+		// changed by queries, so it can be queried from several threads at once.
+		class TerrainHeightField
+		{
+			public:
+				// The north west and size are in world units and must be multiples of the sample frequency of the
+				// level of detail.
+				TerrainHeightField(const TerrainSource& source, const Vector2i& northWest, const Vector2ui& size,
+								   unsigned int lodIndex = 0, unsigned int sampleFrequency = 1);
+
+				// Whether the segment between the two points does not pass through the terrain.
+				bool lineOfSight(const Vector3& from, const Vector3& to) const;
+
+				// Whether the ray meets the terrain within the distance, hit receives the first point it meets.
+				bool raycast(const Vector3& origin, const Vector3& direction, float maxDistance, Vector3& hit) const;
+
+			private:
+				struct Level
+				{
+					Vector2ui cells;
+
+					std::vector<float> maximumHeights;
+				};
+
+				// A ray in cell units, its parameter is the distance along it in world units.
+				struct Ray
+				{
+					Vector3 direction;
+
+					Vector3 origin;
+				};
+
+				Vector2ui cells;
+
+				std::vector<float> heightMap;
+
+				std::vector<Level> levels;
+
+				Vector2i northWest;
+
+				float scale;
+
+				bool intersect(const Ray& ray, unsigned int level, const Vector2ui& node, float first, float last,
+							   float& distance) const;
+
+				bool intersectCell(const Ray& ray, const Vector2ui& cell, float first, float last,
+								   float& distance) const;
+
+				bool intersectNode(const Ray& ray, unsigned int level, const Vector2ui& node, float& first,
+								   float& last) const;
+
+				Ray toRay(const Vector3& origin, const Vector3& direction) const;
+		};
+	}
+}
+
+#endif //TERRAINHEIGHTFIELD_H
@@ -0,0 +1,296 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <cstdint>
+#include <stdexcept>
+
+#include "TerrainLayout.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		TerrainLayout::TerrainLayout(const Vector2ui& mapSize, const vector<LevelOfDetail>& lods, Type type,
+									 unsigned int tileSize, Encoding encoding, Normals normals) :
+			encoding(encoding),
+			heightOffsets(),
+			lods(lods),
+			mapSize(mapSize),
+			normalOffsets(),
+			normals(normals),
+			size(0),
+			tileSize(tileSize),
+			type(type)
+		{
+			if (type == Type::LINEAR && encoding != Encoding::FLOAT)
+			{
+				throw invalid_argument("Quantized encodings need a tiled layout.");
+			}
+
+			if (this->lods.size() == 0)
+			{
+				LevelOfDetail levelOfDetail;
+				levelOfDetail.layerCount = 1;
+				levelOfDetail.sampleFrequency = 1;
+				this->lods.push_back(levelOfDetail);
+			}
+
+			for (unsigned int lodIndex = 0; lodIndex < this->lods.size(); lodIndex++)
+			{
+				if (type == Type::TILED)
+				{
+					if (tileSize == 0 || tileSize % this->lods[lodIndex].sampleFrequency != 0)
+					{
+						throw invalid_argument("Tiles must be a whole number of samples at every level of detail.");
+					}
+
+					// The offsets are those of the first tile.
+					heightOffsets.push_back(size + getTileComponentOffset(lodIndex, Component::HEIGHTS));
+					normalOffsets.push_back(size + getTileComponentOffset(lodIndex, Component::NORMALS));
+
+					Vector2ui tileCount = getTileCount(lodIndex);
+					size += getTileBytes(lodIndex) * tileCount.X() * tileCount.Y();
+				}
+				else
+				{
+					Vector2ui lodSamples = getLodSamples(lodIndex);
+					size_t sampleCount = static_cast<size_t>(lodSamples.X()) * lodSamples.Y();
+
+					heightOffsets.push_back(size);
+					size += sampleCount * HEIGHT_STRIDE;
+					normalOffsets.push_back(size);
+
+					if (normals == Normals::STORED)
+					{
+						size += sampleCount * NORMAL_STRIDE;
+					}
+				}
+			}
+		}
+
+		void TerrainLayout::getBlocks(unsigned int lodIndex, const Vector2i& sectionNorthWest,
+									  const Vector2ui& sectionSamples, Component component,
+									  unsigned int destinationStride, vector<Block>& blocks,
+									  vector<TileRegion>& regions) const
+		{
+			unsigned int stride = getStride(component);
+			blocks.clear();
+
+			if (type == Type::LINEAR)
+			{
+				size_t componentOffset =
+						component == Component::HEIGHTS ? getHeightOffset(lodIndex) : getNormalOffset(lodIndex);
+
+				Vector2i resourceNorthWest = toResourceSpace(lodIndex, sectionNorthWest);
+				unsigned int sectionX = resourceNorthWest.X();
+				unsigned int sectionY = resourceNorthWest.Y();
+
+				Block block;
+				block.destinationOffset = 0;
+				block.destinationRowStride = sectionSamples.X() * destinationStride;
+				block.rowStride = getLodSamples(lodIndex).X() * stride;
+				block.offset = componentOffset + sectionY * block.rowStride + sectionX * stride;
+				block.rows = sectionSamples.Y();
+				block.rowSize = sectionSamples.X() * stride;
+				blocks.push_back(block);
+
+				return;
+			}
+
+			unsigned int tileSamples = getTileSamples(lodIndex);
+
+			getTileRegions(lodIndex, sectionNorthWest, sectionSamples, regions);
+
+			for (const TileRegion& region : regions)
+			{
+				Block block;
+				block.destinationOffset = (region.sectionNorthWest.Y() * sectionSamples.X() +
+						region.sectionNorthWest.X()) * destinationStride;
+				block.destinationRowStride = sectionSamples.X() * destinationStride;
+				block.rowStride = tileSamples * stride;
+				block.offset = getTileOffset(lodIndex, region.tile) + getTileComponentOffset(lodIndex, component) +
+						(region.tileNorthWest.Y() * tileSamples + region.tileNorthWest.X()) * stride;
+				block.rows = region.samples.Y();
+				block.rowSize = region.samples.X() * stride;
+				blocks.push_back(block);
+			}
+		}
+
+		TerrainLayout::Encoding TerrainLayout::getEncoding() const
+		{
+			return encoding;
+		}
+
+		size_t TerrainLayout::getHeightOffset(unsigned int lodIndex) const
+		{
+			return heightOffsets[lodIndex];
+		}
+
+		const vector<LevelOfDetail>& TerrainLayout::getLods() const
+		{
+			return lods;
+		}
+
+		Vector2ui TerrainLayout::getLodSamples(unsigned int lodIndex) const
+		{
+			Vector2ui lodSize = mapSize / lods[lodIndex].sampleFrequency;
+
+			return Vector2ui(lodSize.X() + 1, lodSize.Y() + 1);
+		}
+
+		const Vector2ui& TerrainLayout::getMapSize() const
+		{
+			return mapSize;
+		}
+
+		size_t TerrainLayout::getNormalOffset(unsigned int lodIndex) const
+		{
+			return normalOffsets[lodIndex];
+		}
+
+		TerrainLayout::Normals TerrainLayout::getNormals() const
+		{
+			return normals;
+		}
+
+		size_t TerrainLayout::getSize() const
+		{
+			return size;
+		}
+
+		unsigned int TerrainLayout::getStride(Component component) const
+		{
+			if (encoding == Encoding::FLOAT)
+			{
+				return component == Component::HEIGHTS ? HEIGHT_STRIDE : NORMAL_STRIDE;
+			}
+
+			if (component == Component::HEIGHTS)
+			{
+				return sizeof(uint16_t);
+			}
+
+			return encoding == Encoding::QUANTIZED_8 ? sizeof(uint8_t) * 2 : sizeof(uint16_t) * 2;
+		}
+
+		size_t TerrainLayout::getTileBytes(unsigned int lodIndex) const
+		{
+			if (normals == Normals::DERIVED)
+			{
+				return getTileComponentOffset(lodIndex, Component::NORMALS);
+			}
+
+			unsigned int tileSamples = getTileSamples(lodIndex);
+			size_t tileSampleCount = static_cast<size_t>(tileSamples) * tileSamples;
+
+			return getTileComponentOffset(lodIndex, Component::NORMALS) +
+					tileSampleCount * getStride(Component::NORMALS);
+		}
+
+		size_t TerrainLayout::getTileComponentOffset(unsigned int lodIndex, Component component) const
+		{
+			size_t headerSize = encoding == Encoding::FLOAT ? 0 : TILE_HEADER_SIZE;
+
+			if (component == Component::HEIGHTS)
+			{
+				return headerSize;
+			}
+
+			unsigned int tileSamples = getTileSamples(lodIndex);
+			size_t tileSampleCount = static_cast<size_t>(tileSamples) * tileSamples;
+
+			return headerSize + tileSampleCount * getStride(Component::HEIGHTS);
+		}
+
+		Vector2ui TerrainLayout::getTileCount(unsigned int lodIndex) const
+		{
+			Vector2ui lodSamples = getLodSamples(lodIndex);
+			unsigned int tileStep = getTileSamples(lodIndex) - 1;
+
+			return Vector2ui((lodSamples.X() - 1 + tileStep - 1) / tileStep,
+							 (lodSamples.Y() - 1 + tileStep - 1) / tileStep);
+		}
+
+		size_t TerrainLayout::getTileOffset(unsigned int lodIndex, const Vector2ui& tile) const
+		{
+			Vector2ui tileCount = getTileCount(lodIndex);
+
+			return heightOffsets[lodIndex] - getTileComponentOffset(lodIndex, Component::HEIGHTS) +
+					(static_cast<size_t>(tile.Y()) * tileCount.X() + tile.X()) * getTileBytes(lodIndex);
+		}
+
+		void TerrainLayout::getTileRegions(unsigned int lodIndex, const Vector2i& sectionNorthWest,
+										   const Vector2ui& sectionSamples, vector<TileRegion>& regions) const
+		{
+			Vector2i resourceNorthWest = toResourceSpace(lodIndex, sectionNorthWest);
+			unsigned int sectionX = resourceNorthWest.X();
+			unsigned int sectionY = resourceNorthWest.Y();
+
+			unsigned int tileStep = getTileSamples(lodIndex) - 1;
+			Vector2ui tileCount = getTileCount(lodIndex);
+
+			// The last sample of a section can come from the border of the tile before it, so a chunk aligned
+			// section is a single tile.
+			unsigned int firstTileX = min(sectionX / tileStep, tileCount.X() - 1);
+			unsigned int firstTileY = min(sectionY / tileStep, tileCount.Y() - 1);
+			unsigned int lastTileX = min((sectionX + max(sectionSamples.X(), 2u) - 2) / tileStep, tileCount.X() - 1);
+			unsigned int lastTileY = min((sectionY + max(sectionSamples.Y(), 2u) - 2) / tileStep, tileCount.Y() - 1);
+
+			regions.clear();
+
+			for (unsigned int tileY = firstTileY; tileY <= lastTileY; tileY++)
+			{
+				for (unsigned int tileX = firstTileX; tileX <= lastTileX; tileX++)
+				{
+					unsigned int firstColumn = max(sectionX, tileX * tileStep);
+					unsigned int lastColumn = min(sectionX + sectionSamples.X() - 1, tileX * tileStep + tileStep);
+					unsigned int firstRow = max(sectionY, tileY * tileStep);
+					unsigned int lastRow = min(sectionY + sectionSamples.Y() - 1, tileY * tileStep + tileStep);
+
+					TileRegion region;
+					region.samples = Vector2ui(lastColumn - firstColumn + 1, lastRow - firstRow + 1);
+					region.sectionNorthWest = Vector2ui(firstColumn - sectionX, firstRow - sectionY);
+					region.tile = Vector2ui(tileX, tileY);
+					region.tileNorthWest = Vector2ui(firstColumn - tileX * tileStep, firstRow - tileY * tileStep);
+					regions.push_back(region);
+				}
+			}
+		}
+
+		unsigned int TerrainLayout::getTileSamples(unsigned int lodIndex) const
+		{
+			return tileSize / lods[lodIndex].sampleFrequency + 1;
+		}
+
+		unsigned int TerrainLayout::getTileSize() const
+		{
+			return tileSize;
+		}
+
+		TerrainLayout::Type TerrainLayout::getType() const
+		{
+			return type;
+		}
+
+		Vector2i TerrainLayout::toResourceSpace(unsigned int lodIndex, const Vector2i& position) const
+		{
+			Vector2ui lodSamples = getLodSamples(lodIndex);
+
+			Vector2i resourcePosition = position;
+			resourcePosition.X() += lodSamples.X() / 2;
+			resourcePosition.Y() += lodSamples.Y() / 2;
+
+			return resourcePosition;
+		}
+	}
+}
@@ -0,0 +1,166 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef TERRAINLAYOUT_H
+#define TERRAINLAYOUT_H
+
+#include <simplicity/math/Vector.h>
+
+#include "LevelOfDetail.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		class TerrainLayout
+		{
+			public:
+				// A run of rows to copy from the resource into a section.
+				struct Block
+				{
+					std::size_t destinationOffset;
+
+					std::size_t destinationRowStride;
+
+					std::size_t offset;
+
+					unsigned int rows;
+
+					std::size_t rowSize;
+
+					std::size_t rowStride;
+				};
+
+				enum class Component
+				{
+					HEIGHTS,
+					NORMALS
+				};
+
+				enum class Encoding
+				{
+					FLOAT,
+
+					// 16 bit heights scaled between the minimum and maximum of each tile and 2 x 8 bit octahedral
+					// normals. Tiled layouts only.
+					QUANTIZED_8,
+
+					// As QUANTIZED_8 but with 2 x 16 bit octahedral normals.
+					QUANTIZED_16
+				};
+
+				enum class Normals
+				{
+					STORED,
+
+					// No normals are stored, sources derive them from the heights.
+					DERIVED
+				};
+
+				// The area of a section that falls within one tile.
+				struct TileRegion
+				{
+					Vector2ui samples;
+
+					Vector2ui sectionNorthWest;
+
+					Vector2ui tile;
+
+					Vector2ui tileNorthWest;
+				};
+
+				enum class Type
+				{
+					// Each LOD is a map array of heights followed by a map array of normals.
+					LINEAR,
+
+					// Each LOD is a grid of tiles holding their heights followed by their normals, border included.
+					TILED
+				};
+
+				static const unsigned int HEIGHT_STRIDE = sizeof(float);
+
+				static const unsigned int NORMAL_STRIDE = sizeof(float) * 3;
+
+				// The minimum height and height scale of a quantized tile.
+				static const unsigned int TILE_HEADER_SIZE = sizeof(float) * 2;
+
+				TerrainLayout(const Vector2ui& mapSize, const std::vector<LevelOfDetail>& lods = {},
+							  Type type = Type::LINEAR, unsigned int tileSize = 0, Encoding encoding = Encoding::FLOAT,
+							  Normals normals = Normals::STORED);
+
+				// The destination offsets are in bytes of a buffer with the given sample stride. The blocks are
+				// written to a caller owned vector so it can be reused between sections, as can the regions, which
+				// tiled layouts use to find the blocks.
+				void getBlocks(unsigned int lodIndex, const Vector2i& sectionNorthWest, const Vector2ui& sectionSamples,
+							   Component component, unsigned int destinationStride, std::vector<Block>& blocks,
+							   std::vector<TileRegion>& regions) const;
+
+				Encoding getEncoding() const;
+
+				std::size_t getHeightOffset(unsigned int lodIndex) const;
+
+				const std::vector<LevelOfDetail>& getLods() const;
+
+				Vector2ui getLodSamples(unsigned int lodIndex) const;
+
+				const Vector2ui& getMapSize() const;
+
+				std::size_t getNormalOffset(unsigned int lodIndex) const;
+
+				Normals getNormals() const;
+
+				std::size_t getSize() const;
+
+				unsigned int getStride(Component component) const;
+
+				std::size_t getTileBytes(unsigned int lodIndex) const;
+
+				std::size_t getTileComponentOffset(unsigned int lodIndex, Component component) const;
+
+				Vector2ui getTileCount(unsigned int lodIndex) const;
+
+				std::size_t getTileOffset(unsigned int lodIndex, const Vector2ui& tile) const;
+
+				void getTileRegions(unsigned int lodIndex, const Vector2i& sectionNorthWest,
+									const Vector2ui& sectionSamples, std::vector<TileRegion>& regions) const;
+
+				unsigned int getTileSamples(unsigned int lodIndex) const;
+
+				unsigned int getTileSize() const;
+
+				Type getType() const;
+
+				Vector2i toResourceSpace(unsigned int lodIndex, const Vector2i& position) const;
+
+			private:
+				Encoding encoding;
+
+				std::vector<std::size_t> heightOffsets;
+
+				std::vector<LevelOfDetail> lods;
+
+				Vector2ui mapSize;
+
+				std::vector<std::size_t> normalOffsets;
+
+				Normals normals;
+
+				std::size_t size;
+
+				unsigned int tileSize;
+
+				Type type;
+		};
+	}
+}
+
+#endif //TERRAINLAYOUT_H
@@ -0,0 +1,80 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <stdexcept>
+
+#include "TerrainMetadata.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		TerrainMetadata::TerrainMetadata(const Resource& resource) :
+			levels(),
+			mapSize(0, 0),
+			nodeSize(0)
+		{
+			unique_ptr<istream> resourceStream = resource.getInputStream();
+
+			unsigned int levelCount = 0;
+			resourceStream->read(reinterpret_cast<char*>(&levelCount), sizeof(unsigned int));
+			resourceStream->read(reinterpret_cast<char*>(&mapSize), sizeof(Vector2ui));
+			resourceStream->read(reinterpret_cast<char*>(&nodeSize), sizeof(unsigned int));
+
+			levels.resize(levelCount);
+			for (Level& level : levels)
+			{
+				resourceStream->read(reinterpret_cast<char*>(&level.sampleFrequency), sizeof(unsigned int));
+				resourceStream->read(reinterpret_cast<char*>(&level.nodeCount), sizeof(Vector2ui));
+
+				level.nodes.resize(level.nodeCount.X() * level.nodeCount.Y());
+				resourceStream->read(reinterpret_cast<char*>(level.nodes.data()), level.nodes.size() * sizeof(Node));
+			}
+
+			if (!*resourceStream)
+			{
+				throw runtime_error("Terrain metadata is smaller than the quadtree it describes.");
+			}
+		}
+
+		unsigned int TerrainMetadata::getLevelCount() const
+		{
+			return levels.size();
+		}
+
+		Vector2ui TerrainMetadata::getMapSize() const
+		{
+			return mapSize;
+		}
+
+		const TerrainMetadata::Node& TerrainMetadata::getNode(unsigned int level, const Vector2ui& node) const
+		{
+			return levels[level].nodes[node.Y() * levels[level].nodeCount.X() + node.X()];
+		}
+
+		Vector2ui TerrainMetadata::getNodeCount(unsigned int level) const
+		{
+			return levels[level].nodeCount;
+		}
+
+		unsigned int TerrainMetadata::getNodeSize() const
+		{
+			return nodeSize;
+		}
+
+		unsigned int TerrainMetadata::getSampleFrequency(unsigned int level) const
+		{
+			return levels[level].sampleFrequency;
+		}
+	}
+}
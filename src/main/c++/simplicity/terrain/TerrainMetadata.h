@@ -0,0 +1,73 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef TERRAINMETADATA_H
+#define TERRAINMETADATA_H
+
+#include <vector>
+
+#include <simplicity/math/Vector.h>
+#include <simplicity/resources/Resource.h>
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// The quadtree of a terrain, as written by TerrainFactory::createMetadata. The nodes of level zero are the
+		// smallest, each level's nodes are twice the size of the level below and are sampled at that level of detail.
+		class TerrainMetadata
+		{
+			public:
+				struct Node
+				{
+					// The furthest the node's level of detail strays from the highest frequency samples it covers.
+					float error;
+
+					float maximumHeight;
+
+					float minimumHeight;
+				};
+
+				TerrainMetadata(const Resource& resource);
+
+				unsigned int getLevelCount() const;
+
+				Vector2ui getMapSize() const;
+
+				const Node& getNode(unsigned int level, const Vector2ui& node) const;
+
+				Vector2ui getNodeCount(unsigned int level) const;
+
+				// The size of the nodes of level zero.
+				unsigned int getNodeSize() const;
+
+				unsigned int getSampleFrequency(unsigned int level) const;
+
+			private:
+				struct Level
+				{
+					Vector2ui nodeCount;
+
+					std::vector<Node> nodes;
+
+					unsigned int sampleFrequency;
+				};
+
+				std::vector<Level> levels;
+
+				Vector2ui mapSize;
+
+				unsigned int nodeSize;
+		};
+	}
+}
+
+#endif //TERRAINMETADATA_H
@@ -0,0 +1,101 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "TerrainPalette.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace
+		{
+			TerrainPalette::Band createBand(const Vector4& color, float minimumHeight, float maximumHeight)
+			{
+				TerrainPalette::Band band;
+				band.color = color;
+				band.maximumHeight = maximumHeight;
+				band.maximumSlope = 1.0f;
+				band.minimumHeight = minimumHeight;
+				band.minimumSlope = 0.0f;
+
+				return band;
+			}
+		}
+
+		TerrainPalette::TerrainPalette() :
+			bands()
+		{
+			float lowest = numeric_limits<float>::lowest();
+			float highest = numeric_limits<float>::max();
+
+			// Grass
+			bands.push_back(createBand(Vector4(0.0f, 0.5f, 0.0f, 1.0f), lowest, highest));
+
+			// Snow, the bands are inclusive so it starts just above 60.
+			bands.push_back(createBand(Vector4(0.8f, 0.8f, 0.8f, 1.0f), nextafter(60.0f, highest), highest));
+
+			// Sand, ending just below 2.
+			bands.push_back(createBand(Vector4(0.83f, 0.65f, 0.15f, 1.0f), lowest, nextafter(2.0f, lowest)));
+		}
+
+		TerrainPalette::TerrainPalette(const vector<Band>& bands) :
+			bands(bands)
+		{
+			if (bands.empty() || bands.size() > numeric_limits<uint8_t>::max() + 1u)
+			{
+				throw invalid_argument("A terrain palette must have between 1 and 256 bands");
+			}
+		}
+
+		void TerrainPalette::classify(const float* heights, const float* slopes, unsigned int count,
+									  uint8_t* materials) const
+		{
+			fill(materials, materials + count, 0);
+
+			// One pass over the samples per band with no branches, so each pass can be vectorized. The limits are
+			// copied out because the materials could otherwise alias them.
+			for (unsigned int bandIndex = 1; bandIndex < bands.size(); bandIndex++)
+			{
+				float maximumHeight = bands[bandIndex].maximumHeight;
+				float maximumSlope = bands[bandIndex].maximumSlope;
+				float minimumHeight = bands[bandIndex].minimumHeight;
+				float minimumSlope = bands[bandIndex].minimumSlope;
+				uint8_t material = static_cast<uint8_t>(bandIndex);
+
+				for (unsigned int index = 0; index < count; index++)
+				{
+					float height = heights[index];
+					float slope = slopes[index];
+					bool within = (height >= minimumHeight) & (height <= maximumHeight) & (slope >= minimumSlope) &
+								  (slope <= maximumSlope);
+					materials[index] = within ? material : materials[index];
+				}
+			}
+		}
+
+		const vector<TerrainPalette::Band>& TerrainPalette::getBands() const
+		{
+			return bands;
+		}
+
+		const Vector4& TerrainPalette::getColor(uint8_t material) const
+		{
+			return bands[material].color;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef TERRAINPALETTE_H
+#define TERRAINPALETTE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <simplicity/math/Vector.h>
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// Colours the terrain by bands of height and slope. A sample takes the last band it is within, the first band
+		// is the one used where no other applies.
+		class TerrainPalette
+		{
+			public:
+				// The ranges are inclusive. Slope runs from zero on flat ground to one on a vertical face.
+				struct Band
+				{
+					Vector4 color;
+
+					float maximumHeight;
+
+					float maximumSlope;
+
+					float minimumHeight;
+
+					float minimumSlope;
+				};
+
+				// Grass, with snow above 60 and sand below 2.
+				TerrainPalette();
+
+				TerrainPalette(const std::vector<Band>& bands);
+
+				// Writes the index of the band of each sample.
+				void classify(const float* heights, const float* slopes, unsigned int count,
+							  std::uint8_t* materials) const;
+
+				const std::vector<Band>& getBands() const;
+
+				const Vector4& getColor(std::uint8_t material) const;
+
+			private:
+				std::vector<Band> bands;
+		};
+	}
+}
+
+#endif //TERRAINPALETTE_H
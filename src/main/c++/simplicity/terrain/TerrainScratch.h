@@ -0,0 +1,61 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef TERRAINSCRATCH_H
+#define TERRAINSCRATCH_H
+
+#include <cstdint>
+#include <vector>
+
+#include <simplicity/math/Vector.h>
+
+#include "TerrainLayout.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// Buffers that reading sections and filling chunks reuse rather than allocating each time. They are owned by
+		// whoever makes the queries, and a scratch can only be used by one thread at a time.
+		struct TerrainScratch
+		{
+			// Used by the sources.
+			std::vector<float> apronHeights;
+
+			std::vector<TerrainLayout::Block> blocks;
+
+			std::vector<char> decodedTile;
+
+			std::vector<float> heights;
+
+			std::vector<TerrainLayout::Block> normalBlocks;
+
+			std::vector<float> paddedHeights;
+
+			std::vector<TerrainLayout::TileRegion> regions;
+
+			std::vector<char> tile;
+
+			// Used by the chunks, around their queries to the sources.
+			std::vector<float> columnPositions;
+
+			std::vector<std::uint8_t> materials;
+
+			std::vector<float> sectionHeights;
+
+			std::vector<Vector3> sectionNormals;
+
+			std::vector<float> slopes;
+		};
+	}
+}
+
+#endif //TERRAINSCRATCH_H
@@ -0,0 +1,49 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include "TerrainCodec.h"
+#include "TerrainSource.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		void TerrainSource::getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									   unsigned int lodIndex, float* heights, unsigned int heightStride,
+									   Vector3* normals, unsigned int normalStride, TerrainScratch& scratch) const
+		{
+			getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heights, heightStride, scratch);
+			getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normals, normalStride, scratch);
+		}
+
+		void TerrainSource::getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											  unsigned int lodIndex, float* heights, unsigned int stride,
+											  TerrainScratch&) const
+		{
+			vector<float> heightMap = getSectionHeights(sectionNorthWest, sectionSize, lodIndex);
+
+			TerrainCodec::copySamples(reinterpret_cast<const char*>(heightMap.data()), heightMap.size(),
+									  sizeof(float), reinterpret_cast<char*>(heights), stride);
+		}
+
+		void TerrainSource::getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											  unsigned int lodIndex, Vector3* normals, unsigned int stride,
+											  TerrainScratch&) const
+		{
+			vector<Vector3> normalMap = getSectionNormals(sectionNorthWest, sectionSize, lodIndex);
+
+			TerrainCodec::copySamples(reinterpret_cast<const char*>(normalMap.data()), normalMap.size(),
+									  sizeof(Vector3), reinterpret_cast<char*>(normals), stride);
+		}
+	}
+}
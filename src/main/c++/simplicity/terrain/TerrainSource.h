@@ -3,6 +3,8 @@
 
 #include <simplicity/math/Vector.h>
 
+#include "TerrainScratch.h"
+
 namespace simplicity
 {
 	namespace terrain
@@ -10,13 +12,37 @@ namespace simplicity
 		class TerrainSource
 		{
 			public:
+				virtual ~TerrainSource()
+				{
+				}
+
+				// Writes the heights and normals of a section in one query. The default implementation makes the two
+				// separate queries.
+				virtual void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+										unsigned int lodIndex, float* heights, unsigned int heightStride,
+										Vector3* normals, unsigned int normalStride, TerrainScratch& scratch) const;
+
 				virtual std::vector<float> getSectionHeights(const Vector2i& sectionNorthWest,
 															 const Vector2ui& sectionSize,
 															 unsigned int lodIndex) const = 0;
 
+				// Writes the heights to the caller's buffer, stride is in bytes. Any buffers the source needs along
+				// the way come from the scratch. The default implementation copies the result of the allocating
+				// overload.
+				virtual void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											   unsigned int lodIndex, float* heights, unsigned int stride,
+											   TerrainScratch& scratch) const;
+
 				virtual std::vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest,
 															   const Vector2ui& sectionSize,
 															   unsigned int lodIndex) const = 0;
+
+				// Writes the normals to the caller's buffer, stride is in bytes. Any buffers the source needs along
+				// the way come from the scratch. The default implementation copies the result of the allocating
+				// overload.
+				virtual void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+											   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+											   TerrainScratch& scratch) const;
 		};
 	}
 }
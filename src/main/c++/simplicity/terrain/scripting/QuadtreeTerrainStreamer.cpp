@@ -0,0 +1,363 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#include <algorithm>
+#include <cmath>
+
+#include <simplicity/math/MathFunctions.h>
+#include <simplicity/Simplicity.h>
+
+#include "QuadtreeTerrainStreamer.h"
+
+using namespace std;
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		namespace
+		{
+			// The view assumed until setErrorThreshold is called, a 1080 pixel high viewport with a 60 degree
+			// vertical field of view.
+			const float DEFAULT_FIELD_OF_VIEW_Y = 1.0471975512f;
+
+			const float DEFAULT_VIEWPORT_HEIGHT = 1080.0f;
+		}
+
+		QuadtreeTerrainStreamer::QuadtreeTerrainStreamer(unique_ptr<TerrainSource> source,
+														 const TerrainMetadata& metadata) :
+			chunks(),
+			culler(),
+			culling(false),
+			errorThreshold(2.0f),
+			eye(0.0f, 0.0f, 0.0f),
+			leafLevels(metadata.getNodeCount(0).X() * metadata.getNodeCount(0).Y(), 0),
+			mapNorthWest(-static_cast<int>(metadata.getMapSize().X()) / 2,
+						 -static_cast<int>(metadata.getMapSize().Y()) / 2),
+			metadata(metadata),
+			modelPool(),
+			palette(new TerrainPalette),
+			pendingModels(),
+			projectionScale(getProjectionScale(DEFAULT_VIEWPORT_HEIGHT, DEFAULT_FIELD_OF_VIEW_Y)),
+			scratch(),
+			source(move(source)),
+			targetEntity(nullptr),
+			targetPosition(0.0f, 0.0f, 0.0f)
+		{
+		}
+
+		void QuadtreeTerrainStreamer::commitModels()
+		{
+			for (unique_ptr<Model>& model : pendingModels)
+			{
+				getEntity()->addComponent(move(model));
+			}
+			pendingModels.clear();
+
+			// Keeps enough models for the whole selection to change, frees the rest.
+			while (modelPool.size() > chunks.size())
+			{
+				getEntity()->removeComponent(*modelPool.back());
+				modelPool.pop_back();
+			}
+		}
+
+		void QuadtreeTerrainStreamer::cullChunks()
+		{
+			if (!culling)
+			{
+				return;
+			}
+
+			vector<TerrainChunk*> selectedChunks;
+			for (auto& chunk : chunks)
+			{
+				selectedChunks.push_back(&chunk.second);
+			}
+
+			culler.cull(eye, selectedChunks);
+		}
+
+		void QuadtreeTerrainStreamer::execute()
+		{
+			if (targetEntity != nullptr)
+			{
+				targetPosition = getPosition3(targetEntity->getTransform());
+			}
+
+			stream();
+			cullChunks();
+		}
+
+		float QuadtreeTerrainStreamer::getHeight(const Vector3& position) const
+		{
+			Vector2ui leafCount = metadata.getNodeCount(0);
+			float nodeSize = static_cast<float>(metadata.getNodeSize());
+
+			int leafX = static_cast<int>(floor((position.X() - mapNorthWest.X()) / nodeSize));
+			int leafY = static_cast<int>(floor((position.Z() - mapNorthWest.Y()) / nodeSize));
+			if (leafX < 0 || leafX >= leafCount.X() ||
+				leafY < 0 || leafY >= leafCount.Y())
+			{
+				return 0.0f;
+			}
+
+			NodeIndex index;
+			index.level = leafLevels[leafY * leafCount.X() + leafX];
+			index.node = Vector2ui(leafX >> index.level, leafY >> index.level);
+
+			auto chunk = chunks.find(index);
+			if (chunk == chunks.end())
+			{
+				return 0.0f;
+			}
+
+			// Relative to chunk.
+			Vector2i northWest = getNorthWest(index);
+			return chunk->second.getHeight(position - Vector3(northWest.X(), 0.0f, northWest.Y()));
+		}
+
+		Vector2i QuadtreeTerrainStreamer::getNorthWest(const NodeIndex& index) const
+		{
+			int size = static_cast<int>(metadata.getNodeSize() << index.level);
+
+			return Vector2i(mapNorthWest.X() + static_cast<int>(index.node.X()) * size,
+							mapNorthWest.Y() + static_cast<int>(index.node.Y()) * size);
+		}
+
+		float QuadtreeTerrainStreamer::getProjectionScale(float viewportHeight, float fieldOfViewY)
+		{
+			return viewportHeight / (2.0f * tan(fieldOfViewY / 2.0f));
+		}
+
+		unsigned int QuadtreeTerrainStreamer::getSelectedNodeCount() const
+		{
+			return chunks.size();
+		}
+
+		bool QuadtreeTerrainStreamer::isDetailedEnough(const NodeIndex& index) const
+		{
+			if (index.level == 0)
+			{
+				return true;
+			}
+
+			const TerrainMetadata::Node& node = metadata.getNode(index.level, index.node);
+			Vector2i northWest = getNorthWest(index);
+			float size = static_cast<float>(metadata.getNodeSize() << index.level);
+
+			// The distance from the target to the node's bounds.
+			float x = max(max(northWest.X() - targetPosition.X(), targetPosition.X() - (northWest.X() + size)), 0.0f);
+			float y = max(max(node.minimumHeight - targetPosition.Y(), targetPosition.Y() - node.maximumHeight), 0.0f);
+			float z = max(max(northWest.Y() - targetPosition.Z(), targetPosition.Z() - (northWest.Y() + size)), 0.0f);
+			float distance = sqrt(x * x + y * y + z * z);
+
+			return node.error * projectionScale <= errorThreshold * distance;
+		}
+
+		void QuadtreeTerrainStreamer::onAddEntity()
+		{
+			stream();
+		}
+
+		void QuadtreeTerrainStreamer::patchEdges(const NodeIndex& index, TerrainChunk& chunk) const
+		{
+			Vector2ui leafCount = metadata.getNodeCount(0);
+			unsigned int span = 1 << index.level;
+			Vector2ui first(index.node.X() * span, index.node.Y() * span);
+
+			// Only coarser neighbours are patched to, finer neighbours patch themselves to this node.
+			auto getPatchSize = [this, &index, &leafCount](unsigned int leafX, unsigned int leafY)
+			{
+				unsigned int level = leafLevels[leafY * leafCount.X() + leafX];
+				return 1u << (max(level, index.level) - index.level);
+			};
+
+			TerrainChunk::Patches patches;
+			patches.east = 1;
+			patches.north = 1;
+			patches.south = 1;
+			patches.west = 1;
+
+			if (first.X() + span < leafCount.X())
+			{
+				patches.east = getPatchSize(first.X() + span, first.Y());
+			}
+			if (first.Y() > 0)
+			{
+				patches.north = getPatchSize(first.X(), first.Y() - 1);
+			}
+			if (first.Y() + span < leafCount.Y())
+			{
+				patches.south = getPatchSize(first.X(), first.Y() + span);
+			}
+			if (first.X() > 0)
+			{
+				patches.west = getPatchSize(first.X() - 1, first.Y());
+			}
+
+			chunk.patch(patches);
+		}
+
+		void QuadtreeTerrainStreamer::select(const NodeIndex& index, vector<NodeIndex>& selection) const
+		{
+			if (isDetailedEnough(index))
+			{
+				selection.push_back(index);
+				return;
+			}
+
+			for (unsigned int child = 0; child < 4; child++)
+			{
+				NodeIndex childIndex;
+				childIndex.level = index.level - 1;
+				childIndex.node = Vector2ui(index.node.X() * 2 + child % 2, index.node.Y() * 2 + child / 2);
+
+				select(childIndex, selection);
+			}
+		}
+
+		void QuadtreeTerrainStreamer::setErrorThreshold(float pixels, float projectionScale)
+		{
+			errorThreshold = pixels;
+			this->projectionScale = projectionScale;
+		}
+
+		void QuadtreeTerrainStreamer::setPalette(const TerrainPalette& palette)
+		{
+			this->palette = make_shared<const TerrainPalette>(palette);
+		}
+
+		void QuadtreeTerrainStreamer::setTarget(const Entity& target)
+		{
+			targetEntity = &target;
+			targetPosition = targetEntity->getPosition();
+		}
+
+		void QuadtreeTerrainStreamer::setTarget(const Vector3& target)
+		{
+			targetEntity = nullptr;
+			targetPosition = target;
+		}
+
+		void QuadtreeTerrainStreamer::setView(const Vector3& eye, const vector<Vector4>& frustum)
+		{
+			culling = true;
+			this->eye = eye;
+			culler.setFrustum(frustum);
+		}
+
+		void QuadtreeTerrainStreamer::stream()
+		{
+			unsigned int rootLevel = metadata.getLevelCount() - 1;
+			Vector2ui rootCount = metadata.getNodeCount(rootLevel);
+
+			vector<NodeIndex> selection;
+			for (unsigned int y = 0; y < rootCount.Y(); y++)
+			{
+				for (unsigned int x = 0; x < rootCount.X(); x++)
+				{
+					NodeIndex root;
+					root.level = rootLevel;
+					root.node = Vector2ui(x, y);
+
+					select(root, selection);
+				}
+			}
+
+			sort(selection.begin(), selection.end());
+
+			// The nodes that are no longer selected are retired first so their models can be reused.
+			bool changed = false;
+			for (auto chunk = chunks.begin(); chunk != chunks.end();)
+			{
+				if (binary_search(selection.begin(), selection.end(), chunk->first))
+				{
+					chunk++;
+					continue;
+				}
+
+				chunk->second.getModel()->setVisible(false);
+				modelPool.push_back(chunk->second.getModel());
+				chunk = chunks.erase(chunk);
+				changed = true;
+			}
+
+			unsigned int chunkSize = metadata.getNodeSize() / metadata.getSampleFrequency(0);
+			for (const NodeIndex& index : selection)
+			{
+				if (chunks.find(index) != chunks.end())
+				{
+					continue;
+				}
+
+				unsigned int scale = metadata.getSampleFrequency(index.level);
+				TerrainChunk& chunk = chunks.insert(make_pair(index, TerrainChunk(chunkSize, scale))).first->second;
+				chunk.setPalette(palette);
+
+				if (modelPool.empty())
+				{
+					pendingModels.push_back(chunk.createModel());
+				}
+				else
+				{
+					chunk.setModel(*modelPool.back());
+					chunk.getModel()->setVisible(true);
+					modelPool.pop_back();
+				}
+
+				Vector2i northWest = getNorthWest(index);
+				chunk.setVertices(northWest, *source, northWest / static_cast<int>(scale), index.level, scratch);
+				changed = true;
+			}
+
+			if (!changed)
+			{
+				return;
+			}
+
+			Vector2ui leafCount = metadata.getNodeCount(0);
+			for (const NodeIndex& index : selection)
+			{
+				unsigned int span = 1 << index.level;
+				for (unsigned int leafY = index.node.Y() * span; leafY < (index.node.Y() + 1) * span; leafY++)
+				{
+					for (unsigned int leafX = index.node.X() * span; leafX < (index.node.X() + 1) * span; leafX++)
+					{
+						leafLevels[leafY * leafCount.X() + leafX] = index.level;
+					}
+				}
+			}
+
+			for (auto& chunk : chunks)
+			{
+				patchEdges(chunk.first, chunk.second);
+			}
+
+			commitModels();
+		}
+
+		bool QuadtreeTerrainStreamer::NodeIndex::operator<(const NodeIndex& other) const
+		{
+			if (level != other.level)
+			{
+				return level < other.level;
+			}
+
+			if (node.X() != other.node.X())
+			{
+				return node.X() < other.node.X();
+			}
+
+			return node.Y() < other.node.Y();
+		}
+	}
+}
@@ -0,0 +1,124 @@
+/*      _                 _ _      _ _
+ *     (_)               | (_)    (_) |
+ *  ___ _ _ __ ___  _ __ | |_  ___ _| |_ _   _
+ * / __| | '_ ` _ \| '_ \| | |/ __| | __| | | |
+ * \__ \ | | | | | | |_) | | | (__| | |_| |_| |
+ * |___/_|_| |_| |_| .__/|_|_|\___|_|\__|\__, |
+ *                 | |                    __/ |
+ *                 |_|                   |___/
+ *
+ * This file is part of simplicity. See the LICENSE file for the full license governing this code.
+ */
+#ifndef QUADTREETERRAINSTREAMER_H
+#define QUADTREETERRAINSTREAMER_H
+
+#include <map>
+
+#include <simplicity/scripting/Script.h>
+
+#include "../ChunkCuller.h"
+#include "../TerrainChunk.h"
+#include "../TerrainMetadata.h"
+#include "../TerrainSource.h"
+
+namespace simplicity
+{
+	namespace terrain
+	{
+		// Streams the nodes of a terrain's quadtree, choosing the largest nodes whose error on screen is within a
+		// threshold instead of using rings of fixed levels of detail. The source's levels of detail must match the
+		// levels of the metadata.
+		class QuadtreeTerrainStreamer : public Script
+		{
+			public:
+				QuadtreeTerrainStreamer(std::unique_ptr<TerrainSource> source, const TerrainMetadata& metadata);
+
+				void execute() override;
+
+				float getHeight(const Vector3& position) const;
+
+				// The pixels on screen per unit of world space at a distance of one, for a viewport of the given height
+				// in pixels and vertical field of view in radians.
+				static float getProjectionScale(float viewportHeight, float fieldOfViewY);
+
+				unsigned int getSelectedNodeCount() const;
+
+				void onAddEntity() override;
+
+				// The projection scale is given by getProjectionScale for the view. Until this is called the threshold
+				// is 2 pixels with the scale of a 1080 pixel high viewport and a 60 degree vertical field of view.
+				void setErrorThreshold(float pixels, float projectionScale);
+
+				// Applies to chunks created after it is set.
+				void setPalette(const TerrainPalette& palette);
+
+				void setTarget(const Entity& target);
+
+				void setTarget(const Vector3& target);
+
+				// From now on the nodes are culled every frame against the frustum and the horizon seen from the
+				// eye, which should be set again whenever the view changes.
+				void setView(const Vector3& eye, const std::vector<Vector4>& frustum);
+
+			private:
+				struct NodeIndex
+				{
+					unsigned int level;
+
+					Vector2ui node;
+
+					bool operator<(const NodeIndex& other) const;
+				};
+
+				std::map<NodeIndex, TerrainChunk> chunks;
+
+				ChunkCuller culler;
+
+				bool culling;
+
+				float errorThreshold;
+
+				Vector3 eye;
+
+				// The level of the selected node covering each node of level zero.
+				std::vector<unsigned int> leafLevels;
+
+				Vector2i mapNorthWest;
+
+				TerrainMetadata metadata;
+
+				// Hidden models kept for reuse, every node has the same number of samples.
+				std::vector<Model*> modelPool;
+
+				std::shared_ptr<const TerrainPalette> palette;
+
+				std::vector<std::unique_ptr<Model>> pendingModels;
+
+				float projectionScale;
+
+				TerrainScratch scratch;
+
+				std::unique_ptr<TerrainSource> source;
+
+				const Entity* targetEntity;
+
+				Vector3 targetPosition;
+
+				void commitModels();
+
+				void cullChunks();
+
+				Vector2i getNorthWest(const NodeIndex& index) const;
+
+				bool isDetailedEnough(const NodeIndex& index) const;
+
+				void patchEdges(const NodeIndex& index, TerrainChunk& chunk) const;
+
+				void select(const NodeIndex& index, std::vector<NodeIndex>& selection) const;
+
+				void stream();
+		};
+	}
+}
+
+#endif //QUADTREETERRAINSTREAMER_H
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <simplicity/math/MathFunctions.h>
 #include <simplicity/model/ModelFactory.h>
 #include <simplicity/Simplicity.h>
@@ -10,21 +12,117 @@ namespace simplicity
 {
 	namespace terrain
 	{
+#ifdef SIMPLE_TERRAIN_STATS
+		namespace
+		{
+			// Times the reads of the streamer and its loader and counts the bytes of the samples read.
+			class MeasuredTerrainSource : public TerrainSource
+			{
+				public:
+					MeasuredTerrainSource(unique_ptr<TerrainSource> source, StreamingStats& stats) :
+						source(move(source)),
+						stats(stats)
+					{
+					}
+
+					void getSection(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+									unsigned int lodIndex, float* heights, unsigned int heightStride,
+									Vector3* normals, unsigned int normalStride, TerrainScratch& scratch) const override
+					{
+						SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::SOURCE);
+						stats.addBytesRead(lodIndex, getSampleCount(sectionSize) * (sizeof(float) + sizeof(Vector3)));
+						source->getSection(sectionNorthWest, sectionSize, lodIndex, heights, heightStride, normals,
+										   normalStride, scratch);
+					}
+
+					vector<float> getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													unsigned int lodIndex) const override
+					{
+						SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::SOURCE);
+						stats.addBytesRead(lodIndex, getSampleCount(sectionSize) * sizeof(float));
+						return source->getSectionHeights(sectionNorthWest, sectionSize, lodIndex);
+					}
+
+					void getSectionHeights(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+										   unsigned int lodIndex, float* heights, unsigned int stride,
+										   TerrainScratch& scratch) const override
+					{
+						SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::SOURCE);
+						stats.addBytesRead(lodIndex, getSampleCount(sectionSize) * sizeof(float));
+						source->getSectionHeights(sectionNorthWest, sectionSize, lodIndex, heights, stride, scratch);
+					}
+
+					vector<Vector3> getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+													  unsigned int lodIndex) const override
+					{
+						SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::SOURCE);
+						stats.addBytesRead(lodIndex, getSampleCount(sectionSize) * sizeof(Vector3));
+						return source->getSectionNormals(sectionNorthWest, sectionSize, lodIndex);
+					}
+
+					void getSectionNormals(const Vector2i& sectionNorthWest, const Vector2ui& sectionSize,
+										   unsigned int lodIndex, Vector3* normals, unsigned int stride,
+										   TerrainScratch& scratch) const override
+					{
+						SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::SOURCE);
+						stats.addBytesRead(lodIndex, getSampleCount(sectionSize) * sizeof(Vector3));
+						source->getSectionNormals(sectionNorthWest, sectionSize, lodIndex, normals, stride, scratch);
+					}
+
+				private:
+					unique_ptr<TerrainSource> source;
+
+					StreamingStats& stats;
+
+					static unsigned long long getSampleCount(const Vector2ui& sectionSize)
+					{
+						return static_cast<unsigned long long>(sectionSize.X()) * sectionSize.Y();
+					}
+			};
+		}
+#endif
+
 		TerrainStreamer::TerrainStreamer(unique_ptr<TerrainSource> source, const Vector2ui& mapSize,
-										 unsigned int chunkSize, const vector<LevelOfDetail>& lods) :
+										 unsigned int chunkSize, const vector<LevelOfDetail>& lods,
+										 unsigned int workerCount) :
 			chunks(),
 			chunkSize(chunkSize),
+			compactMaximumHeight(0.0f),
+			compactMinimumHeight(0.0f),
+			culler(),
+			culling(false),
+			eye(0.0f, 0.0f, 0.0f),
+			generation(0),
+			lastSampledTargetPosition(0.0f, 0.0f, 0.0f),
 			layerMap(),
+			loadedChunk(),
 			lods(lods),
+			mapSize(mapSize),
 			northWestChunk(0, 0),
 			northWestPosition(0.0f, 0.0f, 0.0f),
 			mapNorthWest(-static_cast<int>(mapSize.X()) / 2, -static_cast<int>(mapSize.Y()) / 2),
 			mapSouthEast(mapSize.X() / 2 - chunkSize, mapSize.Y() / 2 - chunkSize),
+			modelPool(),
+			palette(new TerrainPalette),
+			pendingGenerations(),
+			pendingModels(),
+			pendingWraps(),
+			prefetchFrames(0.0f),
+			prefetchHitCount(0),
 			radius(0),
+			rebuildChunkBudget(0),
+			rebuildQueue(),
+			rebuildTimeBudget(0),
+			scratch(),
 			size(0),
 			source(move(source)),
+			stagedChunks(),
+			stagingCapacity(0),
+			stats(max(lods.size(), static_cast<size_t>(1))),
+			loader(),
 			targetEntity(nullptr),
-			targetPosition(0.0f, 0.0f, 0.0f)
+			targetPosition(0.0f, 0.0f, 0.0f),
+			targetVelocity(0.0f, 0.0f, 0.0f)
 		{
 			// TODO chunkSize must be even! Enforce it!
 			// TODO Also things probably need to be multiples of each-other...
@@ -52,27 +150,176 @@ namespace simplicity
 			size = layer * 2 - 1;
 			northWestPosition.X() -= (radius + 0.5f) * chunkSize;
 			northWestPosition.Z() -= (radius + 0.5f) * chunkSize;
+
+#ifdef SIMPLE_TERRAIN_STATS
+			this->source = unique_ptr<TerrainSource>(new MeasuredTerrainSource(move(this->source), stats));
+#endif
+
+			if (workerCount > 0)
+			{
+				loader = unique_ptr<ChunkLoader>(new ChunkLoader(*this->source, workerCount));
+			}
+		}
+
+		void TerrainStreamer::commitLoadedChunks(unsigned int& rebuiltChunkCount,
+												 const chrono::steady_clock::time_point& start)
+		{
+			if (loader == nullptr)
+			{
+				return;
+			}
+
+			while (isWithinRebuildBudget(rebuiltChunkCount, start) && pollLoadedChunk())
+			{
+				unsigned int x = loadedChunk.request.x;
+				unsigned int y = loadedChunk.request.y;
+
+				if (loadedChunk.request.prefetch)
+				{
+					auto stagedChunk = findStagedChunk(loadedChunk.request.chunkNorthWest, loadedChunk.request.lodIndex);
+					if (stagedChunk == stagedChunks.end())
+					{
+						continue;
+					}
+
+					if (stagedChunk->generation == 0 ||
+						pendingGenerations[stagedChunk->x][stagedChunk->y] != stagedChunk->generation)
+					{
+						// The loader gets the staged chunk's empty buffer back for reuse.
+						stagedChunk->generation = 0;
+						stagedChunk->ready = true;
+						swap(stagedChunk->compactVertices, loadedChunk.compactVertices);
+						swap(stagedChunk->vertices, loadedChunk.vertices);
+
+						continue;
+					}
+
+					// A rebuild was waiting for it.
+					x = stagedChunk->x;
+					y = stagedChunk->y;
+					stagedChunks.erase(stagedChunk);
+					prefetchHitCount++;
+				}
+				else if (pendingGenerations[x][y] != loadedChunk.request.generation)
+				{
+					// Superseded by a later request or the chunk has left the map.
+					continue;
+				}
+
+				pendingGenerations[x][y] = 0;
+
+				replaceChunk(x, y, TerrainChunk(loadedChunk.request.sectionSize.X(), loadedChunk.request.scale));
+				commitVertices(x, y, loadedChunk.request.chunkNorthWest, loadedChunk.vertices,
+							   loadedChunk.compactVertices);
+				SIMPLE_TERRAIN_RECORD(stats.addChunkRebuilt());
+
+				patchEdges(chunks[x][y], (x - northWestChunk.X() + size) % size, (y - northWestChunk.Y() + size) % size);
+				rebuiltChunkCount++;
+			}
+
+			commitModels();
+		}
+
+		void TerrainStreamer::commitModels()
+		{
+			for (unique_ptr<Model>& model : pendingModels)
+			{
+				getEntity()->addComponent(move(model));
+			}
+			pendingModels.clear();
+
+			// Keeps enough models for a ring of chunks to change size, frees the rest.
+			for (auto& pooledModels : modelPool)
+			{
+				while (pooledModels.second.size() > size)
+				{
+					getEntity()->removeComponent(*pooledModels.second.back());
+					pooledModels.second.pop_back();
+				}
+			}
+		}
+
+		void TerrainStreamer::commitVertices(unsigned int x, unsigned int y, const Vector2i& chunkNorthWest,
+											 const vector<Vertex>& vertices,
+											 const TerrainChunk::CompactVertices& compactVertices)
+		{
+			SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::VERTICES);
+
+			if (compactVertices.vertices.empty())
+			{
+				chunks[x][y].setVertices(vertices);
+			}
+			else
+			{
+				chunks[x][y].setVertices(chunkNorthWest, compactVertices);
+			}
+		}
+
+		void TerrainStreamer::cullChunks()
+		{
+			if (!culling)
+			{
+				return;
+			}
+
+			vector<TerrainChunk*> streamedChunks;
+			for (vector<TerrainChunk>& column : chunks)
+			{
+				for (TerrainChunk& chunk : column)
+				{
+					streamedChunks.push_back(&chunk);
+				}
+			}
+
+			culler.cull(eye, streamedChunks);
 		}
 
 		void TerrainStreamer::execute()
 		{
+			// Loaded, staged and synchronously rebuilt chunks are all committed within the same budget.
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			unsigned int rebuiltChunkCount = 0;
+
+			commitLoadedChunks(rebuiltChunkCount, start);
+
 			if (targetEntity != nullptr)
 			{
 				targetPosition = getPosition3(targetEntity->getTransform());
 			}
 
+			targetVelocity = targetVelocity * 0.5f + (targetPosition - lastSampledTargetPosition) * 0.5f;
+			lastSampledTargetPosition = targetPosition;
+
 			Vector3 relativePosition = toRelativePosition(targetPosition, true);
 			Vector2i relativeChunkPosition = toChunkPosition(relativePosition);
 
-			if (relativeChunkPosition.X() == 0 && relativeChunkPosition.Y() == 0)
+			if (relativeChunkPosition.X() != 0 || relativeChunkPosition.Y() != 0)
 			{
-				// Not enough movement to require terrain streaming.
-				return;
+				northWestPosition += toWorldPosition(relativeChunkPosition);
+
+				stream(relativeChunkPosition);
 			}
 
-			northWestPosition += toWorldPosition(relativeChunkPosition);
+			rebuildChunks(rebuiltChunkCount, start);
+			cullChunks();
 
-			stream(relativeChunkPosition);
+			SIMPLE_TERRAIN_RECORD(recordFrame());
+		}
+
+		deque<TerrainStreamer::StagedChunk>::iterator TerrainStreamer::findStagedChunk(const Vector2i& chunkNorthWest,
+																					   unsigned int lodIndex)
+		{
+			for (auto iterator = stagedChunks.begin(); iterator != stagedChunks.end(); iterator++)
+			{
+				if (iterator->chunkNorthWest.X() == chunkNorthWest.X() &&
+					iterator->chunkNorthWest.Y() == chunkNorthWest.Y() &&
+					iterator->lodIndex == lodIndex)
+				{
+					return iterator;
+				}
+			}
+
+			return stagedChunks.end();
 		}
 
 		float TerrainStreamer::getHeight(const Vector3& position) const
@@ -91,18 +338,623 @@ namespace simplicity
 			unsigned int x = (chunkPosition.X() + northWestChunk.X()) % size;
 			unsigned int y = (chunkPosition.Y() + northWestChunk.Y()) % size;
 
+			if (pendingGenerations[x][y] != 0 && pendingWraps[x][y])
+			{
+				return 0.0f;
+			}
+
 			return chunks[x][y].getHeight(relativePosition);
 		}
 
+		void TerrainStreamer::getHeights(const Vector3* positions, unsigned int count, float* heights) const
+		{
+			// Runs of positions in the same chunk are queried a batch at a time so that nothing is allocated.
+			const unsigned int batchSize = 64;
+			Vector3 chunkPositions[batchSize];
+
+			unsigned int first = 0;
+			while (first < count)
+			{
+				Vector2i chunkPosition = toChunkPosition(toRelativePosition(positions[first]));
+				if (chunkPosition.X() < 0 || chunkPosition.X() >= size ||
+					chunkPosition.Y() < 0 || chunkPosition.Y() >= size)
+				{
+					heights[first] = 0.0f;
+					first++;
+					continue;
+				}
+
+				Vector3 chunkNorthWest = northWestPosition + toWorldPosition(chunkPosition);
+
+				unsigned int last = first;
+				while (last < count && last - first < batchSize)
+				{
+					Vector2i nextChunkPosition = toChunkPosition(toRelativePosition(positions[last]));
+					if (nextChunkPosition.X() != chunkPosition.X() || nextChunkPosition.Y() != chunkPosition.Y())
+					{
+						break;
+					}
+
+					// Relative to chunk.
+					chunkPositions[last - first] = positions[last] - chunkNorthWest;
+					last++;
+				}
+
+				unsigned int x = (chunkPosition.X() + northWestChunk.X()) % size;
+				unsigned int y = (chunkPosition.Y() + northWestChunk.Y()) % size;
+
+				if (pendingGenerations[x][y] != 0 && pendingWraps[x][y])
+				{
+					fill(heights + first, heights + last, 0.0f);
+				}
+				else
+				{
+					chunks[x][y].getHeights(chunkPositions, last - first, heights + first);
+				}
+
+				first = last;
+			}
+		}
+
+		unsigned int TerrainStreamer::getLodIndex(unsigned int x, unsigned int y) const
+		{
+			unsigned int xDistance = max(x, radius) - min(x, radius);
+			unsigned int yDistance = max(y, radius) - min(y, radius);
+
+			return layerMap.at(max(xDistance, yDistance));
+		}
+
+		unsigned int TerrainStreamer::getPendingChunkCount() const
+		{
+			unsigned int pendingChunkCount = 0;
+
+			for (const vector<unsigned int>& column : pendingGenerations)
+			{
+				for (unsigned int pendingGeneration : column)
+				{
+					if (pendingGeneration != 0)
+					{
+						pendingChunkCount++;
+					}
+				}
+			}
+
+			return pendingChunkCount;
+		}
+
+		unsigned long TerrainStreamer::getPrefetchHitCount() const
+		{
+			return prefetchHitCount;
+		}
+
+		const StreamingStats& TerrainStreamer::getStats() const
+		{
+			return stats;
+		}
+
+		bool TerrainStreamer::isInMap(const Vector2i& chunkNorthWest) const
+		{
+			if (mapSize.X() == 0 || mapSize.Y() == 0)
+			{
+				return true;
+			}
+
+			if (chunkNorthWest.X() < mapNorthWest.X() ||
+				chunkNorthWest.Y() < mapNorthWest.Y() ||
+				chunkNorthWest.X() > mapSouthEast.X() ||
+				chunkNorthWest.Y() > mapSouthEast.Y())
+			{
+				return false;
+			}
+
+			return true;
+		}
+
+		bool TerrainStreamer::isWithinRebuildBudget(unsigned int rebuiltChunkCount,
+													const chrono::steady_clock::time_point& start) const
+		{
+			if (rebuildChunkBudget != 0 && rebuiltChunkCount >= rebuildChunkBudget)
+			{
+				return false;
+			}
+
+			if (rebuildTimeBudget.count() != 0 && chrono::steady_clock::now() - start >= rebuildTimeBudget)
+			{
+				return false;
+			}
+
+			return true;
+		}
+
 		void TerrainStreamer::onAddEntity()
 		{
 			chunks.reserve(size);
+			pendingGenerations.reserve(size);
+			pendingWraps.reserve(size);
 			for (unsigned int x = 0; x < size; x++)
 			{
 				chunks.push_back(vector<TerrainChunk>(size, TerrainChunk(0, 0)));
+				pendingGenerations.push_back(vector<unsigned int>(size, 0));
+				pendingWraps.push_back(vector<bool>(size, false));
 			}
 
+			// The target has not moved before the first frame.
+			lastSampledTargetPosition = targetPosition;
+
 			stream(Vector2i(size, size));
+
+			unsigned int rebuiltChunkCount = 0;
+			rebuildChunks(rebuiltChunkCount, chrono::steady_clock::now());
+		}
+
+		void TerrainStreamer::patchEdges(TerrainChunk& chunk, unsigned int x, unsigned int y)
+		{
+			SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::PATCH);
+
+			unsigned int xDistance = max(x, radius) - min(x, radius);
+			unsigned int yDistance = max(y, radius) - min(y, radius);
+			unsigned int layer = max(xDistance, yDistance);
+			unsigned int lodIndex = layerMap.at(layer);
+
+			TerrainChunk::Patches patches;
+			patches.east = 1;
+			patches.north = 1;
+			patches.south = 1;
+			patches.west = 1;
+
+			if (lodIndex < lods.size() - 1 &&
+				layerMap.at(layer + 1) != lodIndex)
+			{
+				unsigned int scale = lods[lodIndex].sampleFrequency;
+				unsigned int nextScale = lods[lodIndex + 1].sampleFrequency;
+				unsigned int scaleRatio = nextScale / scale;
+
+				if (xDistance == layer)
+				{
+					if (x <= radius)
+					{
+						patches.west = scaleRatio;
+					}
+					if (x >= radius)
+					{
+						patches.east = scaleRatio;
+					}
+				}
+				if (yDistance == layer)
+				{
+					if (y <= radius)
+					{
+						patches.north = scaleRatio;
+					}
+					if (y >= radius)
+					{
+						patches.south = scaleRatio;
+					}
+				}
+			}
+
+			// Only copies indices into the mesh when the patches have changed.
+			chunk.patch(patches);
+		}
+
+		bool TerrainStreamer::pollLoadedChunk()
+		{
+			try
+			{
+				return loader->poll(loadedChunk);
+			}
+			catch (...)
+			{
+				const ChunkLoader::Request& request = loadedChunk.request;
+
+				Rebuild rebuild;
+				rebuild.chunkNorthWest = request.chunkNorthWest;
+				// Retried before the others as it has already waited.
+				rebuild.distance = 0;
+				rebuild.generation = request.generation;
+				rebuild.lodIndex = request.lodIndex;
+				rebuild.x = request.x;
+				rebuild.y = request.y;
+
+				if (request.prefetch)
+				{
+					auto stagedChunk = findStagedChunk(request.chunkNorthWest, request.lodIndex);
+					if (stagedChunk == stagedChunks.end())
+					{
+						throw;
+					}
+
+					// A rebuild waiting for it is loaded again directly.
+					rebuild.generation = stagedChunk->generation;
+					rebuild.x = stagedChunk->x;
+					rebuild.y = stagedChunk->y;
+					stagedChunks.erase(stagedChunk);
+				}
+
+				if (rebuild.generation != 0 && pendingGenerations[rebuild.x][rebuild.y] == rebuild.generation)
+				{
+					rebuildQueue.push(rebuild);
+				}
+
+				throw;
+			}
+		}
+
+		void TerrainStreamer::prefetchChunks(unsigned int rebuiltChunkCount,
+											 const chrono::steady_clock::time_point& start)
+		{
+			if (stagingCapacity == 0)
+			{
+				return;
+			}
+
+			Vector3 predictedPosition = targetPosition + targetVelocity * prefetchFrames;
+			Vector2i movement = toChunkPosition(toRelativePosition(predictedPosition, true));
+
+			// Only the next boundary crossing is predicted.
+			movement.X() = max(-1, min(movement.X(), 1));
+			movement.Y() = max(-1, min(movement.Y(), 1));
+
+			if (movement.X() == 0 && movement.Y() == 0)
+			{
+				return;
+			}
+
+			Vector3 predictedNorthWestPosition = northWestPosition + toWorldPosition(movement);
+
+			vector<Rebuild> prefetches;
+			for (unsigned int x = 0; x < size; x++)
+			{
+				for (unsigned int y = 0; y < size; y++)
+				{
+					if (pendingGenerations[x][y] != 0)
+					{
+						continue;
+					}
+
+					unsigned int previousX = (x - northWestChunk.X() + size) % size;
+					unsigned int previousY = (y - northWestChunk.Y() + size) % size;
+
+					int targetX = previousX - movement.X();
+					int targetY = previousY - movement.Y();
+					unsigned int wrappedTargetX = (targetX + size) % size;
+					unsigned int wrappedTargetY = (targetY + size) % size;
+
+					bool wrap = targetX < 0 || targetX >= size || targetY < 0 || targetY >= size;
+					unsigned int targetLodIndex = getLodIndex(wrappedTargetX, wrappedTargetY);
+
+					if (!wrap && targetLodIndex == getLodIndex(previousX, previousY))
+					{
+						continue;
+					}
+
+					Vector2i chunkNorthWest(static_cast<int>(wrappedTargetX * chunkSize + predictedNorthWestPosition.X()),
+											static_cast<int>(wrappedTargetY * chunkSize + predictedNorthWestPosition.Z()));
+
+					if (!isInMap(chunkNorthWest))
+					{
+						continue;
+					}
+
+					unsigned int targetXDistance = max(wrappedTargetX, radius) - min(wrappedTargetX, radius);
+					unsigned int targetYDistance = max(wrappedTargetY, radius) - min(wrappedTargetY, radius);
+
+					Rebuild prefetch;
+					prefetch.chunkNorthWest = chunkNorthWest;
+					prefetch.distance = targetXDistance * targetXDistance + targetYDistance * targetYDistance;
+					prefetch.generation = 0;
+					prefetch.lodIndex = targetLodIndex;
+					prefetch.x = x;
+					prefetch.y = y;
+					prefetches.push_back(prefetch);
+				}
+			}
+
+			// Chunks staged for a different prediction will not be needed, unless a rebuild is waiting for them.
+			for (auto stagedChunk = stagedChunks.begin(); stagedChunk != stagedChunks.end();)
+			{
+				bool predicted = false;
+				for (const Rebuild& prefetch : prefetches)
+				{
+					if (prefetch.chunkNorthWest.X() == stagedChunk->chunkNorthWest.X() &&
+						prefetch.chunkNorthWest.Y() == stagedChunk->chunkNorthWest.Y() &&
+						prefetch.lodIndex == stagedChunk->lodIndex)
+					{
+						predicted = true;
+						break;
+					}
+				}
+
+				if (predicted || stagedChunk->generation != 0)
+				{
+					stagedChunk++;
+				}
+				else
+				{
+					stagedChunk = stagedChunks.erase(stagedChunk);
+				}
+			}
+
+			// Nearest first.
+			sort(prefetches.rbegin(), prefetches.rend());
+
+			for (const Rebuild& prefetch : prefetches)
+			{
+				if (stagedChunks.size() >= stagingCapacity ||
+					(loader == nullptr && !isWithinRebuildBudget(rebuiltChunkCount, start)))
+				{
+					break;
+				}
+
+				if (findStagedChunk(prefetch.chunkNorthWest, prefetch.lodIndex) != stagedChunks.end())
+				{
+					continue;
+				}
+
+				unsigned int scale = lods[prefetch.lodIndex].sampleFrequency;
+				unsigned int scaledChunkSize = chunkSize / scale;
+				Vector2i scaledChunkNorthWest = prefetch.chunkNorthWest / static_cast<int>(scale);
+
+				StagedChunk stagedChunk;
+				stagedChunk.chunkNorthWest = prefetch.chunkNorthWest;
+				stagedChunk.generation = 0;
+				stagedChunk.lodIndex = prefetch.lodIndex;
+				stagedChunk.ready = loader == nullptr;
+				stagedChunk.x = prefetch.x;
+				stagedChunk.y = prefetch.y;
+
+				if (loader != nullptr)
+				{
+					ChunkLoader::Request request;
+					request.chunkNorthWest = prefetch.chunkNorthWest;
+					request.compact = compactMaximumHeight > compactMinimumHeight;
+					request.generation = 0;
+					request.lodIndex = prefetch.lodIndex;
+					request.maximumHeight = compactMaximumHeight;
+					request.minimumHeight = compactMinimumHeight;
+					request.palette = palette;
+					request.prefetch = true;
+					request.scale = static_cast<float>(scale);
+					request.sectionNorthWest = scaledChunkNorthWest;
+					request.sectionSize = Vector2ui(scaledChunkSize, scaledChunkSize);
+					request.x = prefetch.x;
+					request.y = prefetch.y;
+
+					loader->load(request);
+				}
+				else
+				{
+					TerrainChunk chunk(scaledChunkSize, scale);
+					chunk.setPalette(palette);
+
+					if (compactMaximumHeight > compactMinimumHeight)
+					{
+						stagedChunk.compactVertices.maximumHeight = compactMaximumHeight;
+						stagedChunk.compactVertices.minimumHeight = compactMinimumHeight;
+						chunk.fillVertices(*source, scaledChunkNorthWest, prefetch.lodIndex, stagedChunk.compactVertices,
+										   scratch);
+					}
+					else
+					{
+						stagedChunk.vertices.resize((scaledChunkSize + 1) * (scaledChunkSize + 1));
+						chunk.fillVertices(prefetch.chunkNorthWest, *source, scaledChunkNorthWest, prefetch.lodIndex,
+										   stagedChunk.vertices.data(), scratch);
+					}
+					rebuiltChunkCount++;
+				}
+
+				stagedChunks.push_back(move(stagedChunk));
+			}
+		}
+
+		void TerrainStreamer::rebuildChunks(unsigned int& rebuiltChunkCount,
+											const chrono::steady_clock::time_point& start)
+		{
+			// Ready staged chunks over the budget wait for a later frame.
+			vector<Rebuild> deferredRebuilds;
+
+			// Requests to the loader are cheap so they are all made, in order, and its results are budgeted instead.
+			while (!rebuildQueue.empty() && (loader != nullptr || isWithinRebuildBudget(rebuiltChunkCount, start)))
+			{
+				Rebuild rebuild = rebuildQueue.top();
+				rebuildQueue.pop();
+
+				unsigned int x = rebuild.x;
+				unsigned int y = rebuild.y;
+
+				if (pendingGenerations[x][y] != rebuild.generation)
+				{
+					// Superseded by a later rebuild or the chunk has left the map.
+					continue;
+				}
+
+				unsigned int scale = lods[rebuild.lodIndex].sampleFrequency;
+				unsigned int scaledChunkSize = chunkSize / scale;
+				Vector2i scaledChunkNorthWest = rebuild.chunkNorthWest / static_cast<int>(scale);
+
+				auto stagedChunk = findStagedChunk(rebuild.chunkNorthWest, rebuild.lodIndex);
+				if (stagedChunk != stagedChunks.end() && stagedChunk->ready)
+				{
+					if (!isWithinRebuildBudget(rebuiltChunkCount, start))
+					{
+						deferredRebuilds.push_back(rebuild);
+						continue;
+					}
+
+					pendingGenerations[x][y] = 0;
+
+					replaceChunk(x, y, TerrainChunk(scaledChunkSize, scale));
+					commitVertices(x, y, rebuild.chunkNorthWest, stagedChunk->vertices, stagedChunk->compactVertices);
+					SIMPLE_TERRAIN_RECORD(stats.addChunkRebuilt());
+					stagedChunks.erase(stagedChunk);
+					prefetchHitCount++;
+
+					patchEdges(chunks[x][y], (x - northWestChunk.X() + size) % size, (y - northWestChunk.Y() + size) % size);
+					rebuiltChunkCount++;
+
+					continue;
+				}
+
+				if (stagedChunk != stagedChunks.end())
+				{
+					// Still loading, it is committed when it arrives rather than being loaded again.
+					stagedChunk->generation = rebuild.generation;
+					stagedChunk->x = x;
+					stagedChunk->y = y;
+
+					continue;
+				}
+
+				if (loader != nullptr)
+				{
+					ChunkLoader::Request request;
+					request.chunkNorthWest = rebuild.chunkNorthWest;
+					request.compact = compactMaximumHeight > compactMinimumHeight;
+					request.generation = rebuild.generation;
+					request.lodIndex = rebuild.lodIndex;
+					request.maximumHeight = compactMaximumHeight;
+					request.minimumHeight = compactMinimumHeight;
+					request.palette = palette;
+					request.prefetch = false;
+					request.scale = static_cast<float>(scale);
+					request.sectionNorthWest = scaledChunkNorthWest;
+					request.sectionSize = Vector2ui(scaledChunkSize, scaledChunkSize);
+					request.x = x;
+					request.y = y;
+
+					loader->load(request);
+
+					continue;
+				}
+
+				pendingGenerations[x][y] = 0;
+
+				replaceChunk(x, y, TerrainChunk(scaledChunkSize, scale));
+				{
+					// The source's reads are timed separately.
+					SIMPLE_TERRAIN_TIME(stats, StreamingStats::Timer::VERTICES);
+					chunks[x][y].setVertices(rebuild.chunkNorthWest, *source, scaledChunkNorthWest, rebuild.lodIndex,
+											 scratch);
+				}
+				SIMPLE_TERRAIN_RECORD(stats.addChunkRebuilt());
+
+				patchEdges(chunks[x][y], (x - northWestChunk.X() + size) % size, (y - northWestChunk.Y() + size) % size);
+				rebuiltChunkCount++;
+			}
+
+			for (const Rebuild& deferredRebuild : deferredRebuilds)
+			{
+				rebuildQueue.push(deferredRebuild);
+			}
+
+			if (rebuildQueue.empty())
+			{
+				prefetchChunks(rebuiltChunkCount, start);
+			}
+
+			commitModels();
+		}
+
+		void TerrainStreamer::recordFrame()
+		{
+			auto getMeshBytes = [](unsigned int chunkSize)
+			{
+				return (chunkSize + 1) * (chunkSize + 1) * sizeof(Vertex);
+			};
+
+			unsigned int residentChunkCount = 0;
+			size_t residentVertexBytes = 0;
+
+			for (const vector<TerrainChunk>& column : chunks)
+			{
+				for (const TerrainChunk& chunk : column)
+				{
+					if (chunk.getModel() != nullptr)
+					{
+						residentChunkCount++;
+						residentVertexBytes += getMeshBytes(chunk.getSize());
+					}
+				}
+			}
+
+			for (const auto& pooledModels : modelPool)
+			{
+				residentVertexBytes += pooledModels.second.size() * getMeshBytes(pooledModels.first);
+			}
+
+			for (const StagedChunk& stagedChunk : stagedChunks)
+			{
+				residentVertexBytes += stagedChunk.compactVertices.vertices.capacity() * sizeof(TerrainChunk::CompactVertex);
+				residentVertexBytes += stagedChunk.vertices.capacity() * sizeof(Vertex);
+			}
+
+			stats.endFrame(residentChunkCount, residentVertexBytes);
+		}
+
+		void TerrainStreamer::replaceChunk(unsigned int x, unsigned int y, const TerrainChunk& chunk)
+		{
+			retireChunk(x, y);
+
+			chunks[x][y] = chunk;
+			chunks[x][y].setPalette(palette);
+
+			vector<Model*>& pooledModels = modelPool[chunk.getSize()];
+			if (pooledModels.empty())
+			{
+				pendingModels.push_back(chunks[x][y].createModel());
+				return;
+			}
+
+			chunks[x][y].setModel(*pooledModels.back());
+			chunks[x][y].getModel()->setVisible(true);
+			pooledModels.pop_back();
+		}
+
+		void TerrainStreamer::retireChunk(unsigned int x, unsigned int y)
+		{
+			if (chunks[x][y].getModel() == nullptr)
+			{
+				return;
+			}
+
+			chunks[x][y].getModel()->setVisible(false);
+			modelPool[chunks[x][y].getSize()].push_back(chunks[x][y].getModel());
+
+			chunks[x][y] = TerrainChunk(0, 0);
+		}
+
+		void TerrainStreamer::setCompactHeightRange(float minimumHeight, float maximumHeight)
+		{
+			compactMaximumHeight = maximumHeight;
+			compactMinimumHeight = minimumHeight;
+		}
+
+		void TerrainStreamer::setPalette(const TerrainPalette& palette)
+		{
+			this->palette = make_shared<const TerrainPalette>(palette);
+		}
+
+		void TerrainStreamer::setPrefetch(unsigned int stagingCapacity, float frames)
+		{
+			this->stagingCapacity = stagingCapacity;
+			prefetchFrames = frames;
+
+			// Chunks a rebuild is waiting for are kept.
+			auto stagedChunk = stagedChunks.end();
+			while (stagedChunks.size() > stagingCapacity && stagedChunk != stagedChunks.begin())
+			{
+				stagedChunk--;
+				if (stagedChunk->generation == 0)
+				{
+					stagedChunk = stagedChunks.erase(stagedChunk);
+				}
+			}
+		}
+
+		void TerrainStreamer::setRebuildBudget(unsigned int chunkCount, unsigned int microseconds)
+		{
+			rebuildChunkBudget = chunkCount;
+			rebuildTimeBudget = chrono::microseconds(microseconds);
 		}
 
 		void TerrainStreamer::setTarget(const Entity& target)
@@ -117,8 +969,17 @@ namespace simplicity
 			targetPosition = target;
 		}
 
+		void TerrainStreamer::setView(const Vector3& eye, const vector<Vector4>& frustum)
+		{
+			culling = true;
+			this->eye = eye;
+			culler.setFrustum(frustum);
+		}
+
 		void TerrainStreamer::stream(const Vector2i& movement)
 		{
+			SIMPLE_TERRAIN_RECORD(stats.addStreamEvent());
+
 			for (unsigned int x = 0; x < size; x++)
 			{
 				for (unsigned int y = 0; y < size; y++)
@@ -153,74 +1014,42 @@ namespace simplicity
 					int worldY = static_cast<int>(wrappedTargetY * chunkSize + northWestPosition.Z());
 					Vector2i chunkNorthWest(worldX, worldY);
 
-					if (chunkNorthWest.X() < mapNorthWest.X() ||
-						chunkNorthWest.Y() < mapNorthWest.Y() ||
-						chunkNorthWest.X() > mapSouthEast.X() ||
-						chunkNorthWest.Y() > mapSouthEast.Y())
+					if (!isInMap(chunkNorthWest))
 					{
-						if (chunks[x][y].getModel() != nullptr)
-						{
-							chunks[x][y].getModel()->setVisible(false);
-						}
+						// Its model can be used by the chunks that are in the map.
+						retireChunk(x, y);
+						pendingGenerations[x][y] = 0;
 
 						continue;
 					}
 
-					unsigned int scale = lods[targetLodIndex].sampleFrequency;
-					unsigned int scaledChunkSize = chunkSize / scale;
-					Vector2i scaledChunkNorthWest = chunkNorthWest / static_cast<int>(scale);
-					Vector2ui scaledChunkArea(scaledChunkSize, scaledChunkSize);
-
 					if (wrap || targetLodIndex != previousLodIndex)
 					{
-						getEntity()->removeComponent(*chunks[x][y].getModel());
-						chunks[x][y] = TerrainChunk(scaledChunkSize, scale);
-						getEntity()->addComponent(move(chunks[x][y].createModel()));
+						// The current chunk stays visible until its replacement is rebuilt.
+						Rebuild rebuild;
+						rebuild.chunkNorthWest = chunkNorthWest;
+						rebuild.distance = targetXDistance * targetXDistance + targetYDistance * targetYDistance;
+						rebuild.generation = ++generation;
+						rebuild.lodIndex = targetLodIndex;
+						rebuild.x = x;
+						rebuild.y = y;
 
-						vector<float> heightMap = source->getSectionHeights(scaledChunkNorthWest, scaledChunkArea,
-																			targetLodIndex);
-						vector<Vector3> normalMap = source->getSectionNormals(scaledChunkNorthWest, scaledChunkArea,
-																			  targetLodIndex);
+						// A wrap still waiting to be rebuilt is not undone by a level of detail change.
+						pendingWraps[x][y] = wrap || (pendingGenerations[x][y] != 0 && pendingWraps[x][y]);
+						pendingGenerations[x][y] = rebuild.generation;
+						rebuildQueue.push(rebuild);
 
-						chunks[x][y].setVertices(chunkNorthWest, heightMap, normalMap);
-					}
-					else
-					{
-						chunks[x][y].patch(TerrainChunk::Edge::NORTH, 1);
-						chunks[x][y].patch(TerrainChunk::Edge::EAST, 1);
-						chunks[x][y].patch(TerrainChunk::Edge::SOUTH, 1);
-						chunks[x][y].patch(TerrainChunk::Edge::WEST, 1);
+						continue;
 					}
 
-					if (targetLodIndex < lods.size() - 1 &&
-						layerMap.at(targetLayer + 1) != targetLodIndex)
+					if (pendingGenerations[x][y] != 0)
 					{
-						unsigned int nextScale = lods[targetLodIndex + 1].sampleFrequency;
-						unsigned int scaleRatio = nextScale / scale;
-
-						if (targetXDistance == targetLayer)
-						{
-							if (wrappedTargetX <= radius)
-							{
-								chunks[x][y].patch(TerrainChunk::Edge::WEST, scaleRatio);
-							}
-							if (wrappedTargetX >= radius)
-							{
-								chunks[x][y].patch(TerrainChunk::Edge::EAST, scaleRatio);
-							}
-						}
-						if (targetYDistance == targetLayer)
-						{
-							if (wrappedTargetY <= radius)
-							{
-								chunks[x][y].patch(TerrainChunk::Edge::NORTH, scaleRatio);
-							}
-							if (wrappedTargetY >= radius)
-							{
-								chunks[x][y].patch(TerrainChunk::Edge::SOUTH, scaleRatio);
-							}
-						}
+						// The replacement is patched when it is rebuilt.
+						continue;
 					}
+
+					patchEdges(chunks[x][y], wrappedTargetX, wrappedTargetY);
+					SIMPLE_TERRAIN_RECORD(stats.addChunkPatched());
 				}
 			}
 
@@ -228,6 +1057,11 @@ namespace simplicity
 			northWestChunk.Y() = (northWestChunk.Y() + movement.Y() + size) % size;
 		}
 
+		bool TerrainStreamer::Rebuild::operator<(const Rebuild& other) const
+		{
+			return distance > other.distance;
+		}
+
 		Vector2i TerrainStreamer::toChunkPosition(const Vector3& position) const
 		{
 			return Vector2i(static_cast<int>(floor(position.X() / chunkSize)),
@@ -1,10 +1,17 @@
 #ifndef TERRAINSTREAMER_H_
 #define TERRAINSTREAMER_H_
 
+#include <chrono>
+#include <deque>
+#include <queue>
+
 #include <simplicity/model/Mesh.h>
 #include <simplicity/scripting/Script.h>
 
+#include "../ChunkCuller.h"
+#include "../ChunkLoader.h"
 #include "../LevelOfDetail.h"
+#include "../StreamingStats.h"
 #include "../TerrainChunk.h"
 #include "../TerrainSource.h"
 
@@ -15,26 +22,124 @@ namespace simplicity
 		class TerrainStreamer : public Script
 		{
 			public:
+				// A map size of zero leaves the map unbounded, for sources that can supply any section such as a
+				// ProceduralTerrainSource.
 				TerrainStreamer(std::unique_ptr<TerrainSource> source, const Vector2ui& mapSize,
-								unsigned int chunkSize, const std::vector<LevelOfDetail>& lods = {});
+								unsigned int chunkSize, const std::vector<LevelOfDetail>& lods = {},
+								unsigned int workerCount = 0);
 
+				// Rethrows the exception of a chunk that failed to load on the loader's workers, the chunk is loaded
+				// again in a later frame.
 				void execute() override;
 
+				// Zero outside the streamed area and where a chunk is waiting to be rebuilt for another area, as the
+				// chunk there until then belongs to somewhere else. A chunk waiting only to change its level of detail
+				// still covers the same area and answers as before.
 				float getHeight(const Vector3& position) const;
 
+				// Consecutive positions in the same chunk are answered together, so grouping positions by area makes
+				// this faster.
+				void getHeights(const Vector3* positions, unsigned int count, float* heights) const;
+
+				unsigned int getPendingChunkCount() const;
+
+				// The chunks rebuilt from ones that were prefetched rather than read when they were needed.
+				unsigned long getPrefetchHitCount() const;
+
+				// Sampled at the end of every frame, empty unless the library is built with SIMPLE_TERRAIN_STATS.
+				const StreamingStats& getStats() const;
+
 				void onAddEntity() override;
 
+				// Loaded and prefetched chunks are held as compact vertices quantized within the range until they are
+				// committed, a fraction of the memory of full vertices, and heights outside of it are clamped. The
+				// range is shared by every chunk so their edges meet. An empty range, the default, keeps full vertices.
+				// Applies to chunks requested after it is set.
+				void setCompactHeightRange(float minimumHeight, float maximumHeight);
+
+				// Applies to chunks rebuilt after it is set.
+				void setPalette(const TerrainPalette& palette);
+
+				// Loads up to stagingCapacity chunks that the target will need if it keeps moving at its current
+				// velocity for the given number of frames, zero capacity disabling prefetching.
+				void setPrefetch(unsigned int stagingCapacity, float frames);
+
+				// Limits the chunks replaced per frame, nearest first, zero meaning no limit. Chunks waiting for a
+				// replacement stay visible.
+				void setRebuildBudget(unsigned int chunkCount, unsigned int microseconds = 0);
+
 				void setTarget(const Entity& target);
 
 				void setTarget(const Vector3& target);
 
+				// From now on the chunks are culled every frame against the frustum and the horizon seen from the
+				// eye, which should be set again whenever the view changes.
+				void setView(const Vector3& eye, const std::vector<Vector4>& frustum);
+
 			private:
+				struct Rebuild
+				{
+					Vector2i chunkNorthWest;
+
+					unsigned int distance;
+
+					unsigned int generation;
+
+					unsigned int lodIndex;
+
+					unsigned int x;
+
+					unsigned int y;
+
+					// Nearer rebuilds compare greater so they are at the top of the queue.
+					bool operator<(const Rebuild& other) const;
+				};
+
+				struct StagedChunk
+				{
+					Vector2i chunkNorthWest;
+
+					// Of the rebuild waiting for the chunk to finish loading, zero if there is none.
+					// Either these or the full vertices are held, as the chunk was requested.
+					TerrainChunk::CompactVertices compactVertices;
+
+					unsigned int generation;
+
+					unsigned int lodIndex;
+
+					bool ready;
+
+					std::vector<Vertex> vertices;
+
+					unsigned int x;
+
+					unsigned int y;
+				};
+
 				std::vector<std::vector<TerrainChunk>> chunks;
 
 				unsigned int chunkSize;
 
+				float compactMaximumHeight;
+
+				float compactMinimumHeight;
+
+				ChunkCuller culler;
+
+				bool culling;
+
+				Vector3 eye;
+
+				unsigned int generation;
+
+				// The target's position when the velocity was last sampled.
+				Vector3 lastSampledTargetPosition;
+
 				std::map<unsigned int, unsigned int> layerMap;
 
+				// Polled into every frame so the loader can reuse its vertex buffers.
+				ChunkLoader::Result loadedChunk;
+
 				std::vector<LevelOfDetail> lods;
 
 				Vector2ui mapSize;
@@ -45,18 +150,94 @@ namespace simplicity
 
 				Vector2i mapSouthEast;
 
+				// Hidden models kept for reuse by chunks of the same size, they stay components of the entity.
+				std::map<unsigned int, std::vector<Model*>> modelPool;
+
 				Vector3 northWestPosition;
 
+				std::shared_ptr<const TerrainPalette> palette;
+
+				std::vector<std::vector<unsigned int>> pendingGenerations;
+
+				// Models created during a step, added to the entity together at the end of it.
+				std::vector<std::unique_ptr<Model>> pendingModels;
+
+				// Whether the rebuild pending for each slot moves its chunk to another area, rather than only changing
+				// its level of detail.
+				std::vector<std::vector<bool>> pendingWraps;
+
+				float prefetchFrames;
+
+				unsigned long prefetchHitCount;
+
 				unsigned int radius;
 
+				unsigned int rebuildChunkBudget;
+
+				std::priority_queue<Rebuild> rebuildQueue;
+
+				std::chrono::microseconds rebuildTimeBudget;
+
+				// For the chunks built on this thread, the loader's workers have their own.
+				TerrainScratch scratch;
+
 				unsigned int size;
 
 				std::unique_ptr<TerrainSource> source;
 
+				std::deque<StagedChunk> stagedChunks;
+
+				unsigned int stagingCapacity;
+
+				StreamingStats stats;
+
+				// Declared after the source so the workers are joined before the source is destroyed.
+				std::unique_ptr<ChunkLoader> loader;
+
 				const Entity* targetEntity;
 
 				Vector3 targetPosition;
 
+				// Smoothed displacement of the target per frame.
+				Vector3 targetVelocity;
+
+				// Shares the frame's rebuild budget with rebuildChunks, counting into rebuiltChunkCount.
+				void commitLoadedChunks(unsigned int& rebuiltChunkCount,
+										const std::chrono::steady_clock::time_point& start);
+
+				void commitModels();
+
+				// Copies full vertices into the chunk or decodes compact ones, whichever are held.
+				void commitVertices(unsigned int x, unsigned int y, const Vector2i& chunkNorthWest,
+									const std::vector<Vertex>& vertices,
+									const TerrainChunk::CompactVertices& compactVertices);
+
+				void cullChunks();
+
+				std::deque<StagedChunk>::iterator findStagedChunk(const Vector2i& chunkNorthWest, unsigned int lodIndex);
+
+				unsigned int getLodIndex(unsigned int x, unsigned int y) const;
+
+				bool isInMap(const Vector2i& chunkNorthWest) const;
+
+				bool isWithinRebuildBudget(unsigned int rebuiltChunkCount,
+										   const std::chrono::steady_clock::time_point& start) const;
+
+				void patchEdges(TerrainChunk& chunk, unsigned int x, unsigned int y);
+
+				// Rethrows a load that failed once the chunk waiting for it is queued to be rebuilt again.
+				bool pollLoadedChunk();
+
+				void prefetchChunks(unsigned int rebuiltChunkCount, const std::chrono::steady_clock::time_point& start);
+
+				void rebuildChunks(unsigned int& rebuiltChunkCount, const std::chrono::steady_clock::time_point& start);
+
+				void recordFrame();
+
+				void replaceChunk(unsigned int x, unsigned int y, const TerrainChunk& chunk);
+
+				void retireChunk(unsigned int x, unsigned int y);
+
 				void stream(const Vector2i& movement);
 
 				Vector2i toChunkPosition(const Vector3& position) const;